@@ -0,0 +1,224 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2015 Shingo INADA
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+// Runs every problem of a corpus directory under every solver mode and
+// prints one JSON object per run. Each run is a child process, so the peak
+// RSS belongs to that run alone. A problem with a planted answer next to it
+// (name.ans, see problem_gen) also gets its gap to that answer. Where
+// perf_event_open is allowed, the solving thread's cycles, instructions,
+// cache, branch and data TLB misses are added, so that the hugepage mode
+// can be compared on TLB misses; "perf":false marks runs without them.
+// Modes that only change how states are stored must find the default mode's
+// answer; a mismatch is reported and makes the exit status 1.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "common.hpp"
+#include "perf_counters.hpp"
+#include "procon26.hpp"
+
+using namespace std;
+
+struct Mode {
+  string name;
+  map<string, string> extra_parameter;
+  bool same_answer;  // must find the default mode's answer
+};
+
+static vector<Mode> modes() {
+  const char *tmp = getenv("TMPDIR");
+  return {
+      {"default", {}, true},
+      {"noprefetch", {{"prefetch", "0"}}, true},
+      {"hugepage", {{"hugepage", "1"}}, true},
+      {"spill", {{"spill", tmp ? tmp : "/tmp"}}, true},
+      {"mem_limit", {{"mem_limit", "32"}}, false},
+  };
+}
+
+struct Result {
+  int empty = -1;  // -1 when the run failed
+  int stones = 0;
+};
+
+struct Planted {
+  int empty = -1;  // -1 without a planted answer
+  int stones = 0;
+};
+
+// empty cells left by a known answer, counted from its stone sizes.
+static Planted readPlanted(const string &file, const Problem &problem) {
+  Planted planted;
+  ifstream ifs(file);
+  if (!ifs) return planted;
+  const auto answer = SolverAnswerReader::read(ifs, problem);
+  planted.empty = 0;
+  for (const auto &row : problem.field)
+    for (int v : row) planted.empty += !v;
+  for (const auto &put : answer.put_list) {
+    for (const auto &row : problem.stone_list[put.stone_index])
+      for (int v : row) planted.empty -= v;
+  }
+  planted.stones = answer.put_list.size();
+  return planted;
+}
+
+// child side: solve, print the result line and send the result to fd.
+static void runCase(const string &name, const Problem &problem,
+                    const Planted &planted, const Mode &mode,
+                    const SolverParameter &base, int fd) {
+  SolverParameter parameter = base;
+  for (auto &kv : mode.extra_parameter) parameter.extra_parameter.insert(kv);
+  parameter.extra_parameter["answer_files"] = "0";
+
+  PerfCounters perf;
+  const auto start = chrono::steady_clock::now();
+  Solver solver(problem, parameter);
+  perf.start();
+  solver.run();
+  const auto sample = perf.stop();
+  const double wall =
+      chrono::duration<double>(chrono::steady_clock::now() - start).count();
+  const auto stats = solver.stats();
+  rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+
+  printf("{\"problem\":\"%s\",\"mode\":\"%s\",\"beam\":%s,\"wall_s\":%.3f,"
+         "\"search_s\":%.3f,\"expanded\":%zu,\"states_per_s\":%.0f,"
+         "\"peak_rss_mb\":%.1f,\"empty\":%d,\"stones\":%d",
+         name.c_str(), mode.name.c_str(),
+         parameter.extra_parameter["beam"].c_str(), wall, stats.search_seconds,
+         stats.expanded, stats.expanded / max(stats.search_seconds, 1e-9),
+         usage.ru_maxrss / 1024.0, stats.empty, stats.stones);
+  if (planted.empty >= 0) {
+    printf(",\"planted_empty\":%d,\"planted_stones\":%d,\"gap\":%d",
+           planted.empty, planted.stones, stats.empty - planted.empty);
+  }
+  printf(",\"perf\":%s", perf.available() ? "true" : "false");
+  for (int i = 0; i < kPerfEventCount; ++i) {
+    if (sample.value[i] < 0) continue;
+    printf(",\"%s\":%lld", PerfCounters::name(i), (long long)sample.value[i]);
+  }
+  printf("}\n");
+  fflush(stdout);
+  Result result;
+  result.empty = stats.empty;
+  result.stones = stats.stones;
+  if (write(fd, &result, sizeof(result)) != sizeof(result)) _exit(1);
+}
+
+int main(int argc, char *argv[]) {
+  string corpus = "bench/corpus";
+  string output;
+  bool verbose = false;
+  SolverParameter base;
+  base.extra_parameter["beam"] = "20";
+  for (int i = 1; i < argc; ++i) {
+    const string arg = argv[i];
+    if (arg == "-corpus" && i + 1 < argc) {
+      corpus = argv[++i];
+    } else if (arg == "-o" && i + 1 < argc) {
+      output = argv[++i];
+    } else if (arg == "-v") {
+      verbose = true;
+    } else if (arg == "-ex") {
+      for (++i; i + 1 < argc; i += 2) {
+        base.extra_parameter[argv[i]] = argv[i + 1];
+      }
+    } else {
+      cerr << "Usage: solver_bench [-corpus dir] [-o result.jsonl] [-v]"
+           << endl;
+      cerr << " -ex key1 value1 ... (applied to every mode, beam 20 by default)"
+           << endl;
+      return 1;
+    }
+  }
+  if (!output.empty() && !freopen(output.c_str(), "w", stdout)) {
+    cerr << "cannnot open the output. " << output << endl;
+    return 1;
+  }
+
+  int mismatches = 0;
+  for (auto &name : ProblemReader::list(corpus)) {
+    const auto problem = ProblemReader().read(corpus + "/" + name + ".txt");
+    const auto planted = readPlanted(corpus + "/" + name + ".ans", problem);
+    Result expected;
+    for (auto &mode : modes()) {
+      cerr << "[bench] " << name << " " << mode.name << endl;
+      fflush(stdout);
+      int fds[2];
+      if (pipe(fds) != 0) {
+        cerr << "cannnot create a pipe." << endl;
+        return 1;
+      }
+      const pid_t pid = fork();
+      if (pid == 0) {
+        close(fds[0]);
+        if (!verbose) {
+          const int fd = open("/dev/null", O_WRONLY);
+          dup2(fd, STDERR_FILENO);
+        }
+        runCase(name, problem, planted, mode, base, fds[1]);
+        _exit(0);
+      }
+      close(fds[1]);
+      Result result;
+      if (read(fds[0], &result, sizeof(result)) != sizeof(result)) {
+        result = Result();
+      }
+      close(fds[0]);
+      int status = 0;
+      waitpid(pid, &status, 0);
+      if (pid < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        printf("{\"problem\":\"%s\",\"mode\":\"%s\",\"error\":\"status %d\"}\n",
+               name.c_str(), mode.name.c_str(), status);
+        fflush(stdout);
+        continue;
+      }
+      if (mode.name == "default") {
+        expected = result;
+      } else if (mode.same_answer && expected.empty >= 0 &&
+                 (result.empty != expected.empty ||
+                  result.stones != expected.stones)) {
+        cerr << "[bench] " << name << " " << mode.name << " found empty "
+             << result.empty << " stones " << result.stones
+             << ", default found empty " << expected.empty << " stones "
+             << expected.stones << endl;
+        mismatches++;
+      }
+    }
+  }
+  return mismatches ? 1 : 0;
+}
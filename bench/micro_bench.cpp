@@ -0,0 +1,291 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2015 Shingo INADA
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+// Timings of the GameState primitives in the style of google-benchmark.
+// The states are captured part way through real answers of the corpus
+// problems: the solver's own answer at a small beam, or the planted answer
+// when the corpus has one. Where perf_event_open is allowed, the reported
+// batch also gets its cycles, instructions and misses per iteration.
+
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "perf_counters.hpp"
+#include "procon26.hpp"
+#include "sample_solver.hpp"
+
+using namespace std;
+
+template <class T>
+inline void doNotOptimize(const T &value) {
+  asm volatile("" : : "r,m"(value) : "memory");
+}
+
+struct Fixture {
+  string name;  // problem/percent of the answer replayed
+  GameState *state;
+  Point pos;              // getNextTargetPos of state
+  vector<Put> candidate;  // every unused stone and direction at pos
+  vector<Put> available;  // getAvailableList at pos
+};
+
+// a benchmark body runs `iterations` operations.
+struct Benchmark {
+  string name;
+  function<void(size_t)> body;
+};
+
+class MicroBench {
+ public:
+  MicroBench(double min_time, const string &filter)
+      : min_time_(min_time), filter_(filter) {}
+
+  bool matches(const string &name) const {
+    return name.find(filter_) != string::npos;
+  }
+
+  void add(const string &name, function<void(size_t)> body) {
+    if (matches(name)) benchmarks_.push_back({name, body});
+  }
+
+  // doubles the iteration count until one batch takes min_time_.
+  void run() {
+    const bool perf = perf_.available();
+    if (!perf) cerr << "[micro] perf_event_open denied, timing only" << endl;
+    printf("%-48s %12s %12s", "Benchmark", "Time", "Iterations");
+    if (perf) {
+      for (int i = 0; i < kPerfEventCount; ++i) {
+        printf(" %13s", PerfCounters::name(i));
+      }
+    }
+    printf("\n");
+    for (auto &b : benchmarks_) {
+      for (size_t iterations = 1;; iterations *= 2) {
+        perf_.start();
+        const auto start = chrono::steady_clock::now();
+        b.body(iterations);
+        const double sec =
+            chrono::duration<double>(chrono::steady_clock::now() - start)
+                .count();
+        const auto sample = perf_.stop();
+        if (sec >= min_time_ || iterations >= (size_t(1) << 40)) {
+          printf("%-48s %9.1f ns %12zu", b.name.c_str(),
+                 sec * 1e9 / iterations, iterations);
+          for (int i = 0; perf && i < kPerfEventCount; ++i) {
+            if (sample.value[i] < 0) {
+              printf(" %13s", "-");
+            } else {
+              printf(" %13.2f", (double)sample.value[i] / iterations);
+            }
+          }
+          printf("\n");
+          fflush(stdout);
+          break;
+        }
+      }
+    }
+  }
+
+ private:
+  double min_time_;
+  string filter_;
+  vector<Benchmark> benchmarks_;
+  PerfCounters perf_;
+};
+
+// replays the first `count` puts of an answer, as loadSeed does.
+static GameState *replay(const SolverAnswer &answer, size_t count) {
+  const auto puts = GameState::fromAnswer(answer);
+  GameState *s = GameState::alloc()->init();
+  for (size_t n = 0; n < count && n < puts.size(); ++n) {
+    s->addScore(s->calcSimpleScore(puts[n]));
+    s->put(puts[n]);
+  }
+  return s;
+}
+
+// the benchmarks addFixtures registers for each fixture.
+static const char *const kBodies[] = {
+    "BM_available",       "BM_put_undo",         "BM_preHash",
+    "BM_calcSimpleScore", "BM_getAvailableList", "BM_getNextTargetPos",
+    "BM_Field_transform", "BM_clone"};
+static const int kPercents[] = {25, 50, 75};
+
+// the bodies switch `g` to the fixture's problem first.
+static void addFixtures(MicroBench &bench, SolverContext *context,
+                        vector<Fixture> &fixtures) {
+  for (auto &f : fixtures) {
+    const Fixture *p = &f;
+    bench.add("BM_available/" + f.name, [p, context](size_t n) {
+      g = context;
+      const auto &c = p->candidate;
+      for (size_t i = 0; i < n; ++i) {
+        doNotOptimize(p->state->available(c[i % c.size()]));
+      }
+    });
+    bench.add("BM_put_undo/" + f.name, [p, context](size_t n) {
+      g = context;
+      const auto &a = p->available;
+      for (size_t i = 0; i < n; ++i) {
+        p->state->put(a[i % a.size()]);
+        p->state->undo(a[i % a.size()]);
+        doNotOptimize(p->state->getHash());
+      }
+    });
+    bench.add("BM_preHash/" + f.name, [p, context](size_t n) {
+      g = context;
+      const auto &a = p->available;
+      for (size_t i = 0; i < n; ++i) {
+        doNotOptimize(p->state->preHash(a[i % a.size()]));
+      }
+    });
+    bench.add("BM_calcSimpleScore/" + f.name, [p, context](size_t n) {
+      g = context;
+      const auto &a = p->available;
+      for (size_t i = 0; i < n; ++i) {
+        doNotOptimize(p->state->calcSimpleScore(a[i % a.size()]));
+      }
+    });
+    bench.add("BM_getAvailableList/" + f.name, [p, context](size_t n) {
+      g = context;
+      for (size_t i = 0; i < n; ++i) {
+        doNotOptimize(p->state->getAvailableList(p->pos.x, p->pos.y));
+      }
+    });
+    bench.add("BM_getNextTargetPos/" + f.name, [p, context](size_t n) {
+      g = context;
+      for (size_t i = 0; i < n; ++i) {
+        doNotOptimize(SampleSolver::getNextTargetPos(*p->state));
+      }
+    });
+    bench.add("BM_Field_transform/" + f.name, [p, context](size_t n) {
+      g = context;
+      Field field = p->state->getField();
+      for (size_t i = 0; i < n; ++i) {
+        field.transform(i % 8, (i + 1) % 8);
+        doNotOptimize(field);
+      }
+    });
+    bench.add("BM_clone/" + f.name, [p, context](size_t n) {
+      g = context;
+      for (size_t i = 0; i < n; ++i) {
+        GameState *s = p->state->clone();
+        doNotOptimize(s);
+        GameState::free(s);
+      }
+    });
+  }
+}
+
+int main(int argc, char *argv[]) {
+  string corpus = "bench/corpus";
+  string filter;
+  double min_time = 0.5;
+  SolverParameter parameter;
+  parameter.extra_parameter["beam"] = "10";
+  for (int i = 1; i < argc; ++i) {
+    const string arg = argv[i];
+    if (arg == "-corpus" && i + 1 < argc) {
+      corpus = argv[++i];
+    } else if (arg == "-filter" && i + 1 < argc) {
+      filter = argv[++i];
+    } else if (arg == "-min_time" && i + 1 < argc) {
+      min_time = stod(argv[++i]);
+    } else if (arg == "-ex") {
+      for (++i; i + 1 < argc; i += 2) {
+        parameter.extra_parameter[argv[i]] = argv[i + 1];
+      }
+    } else {
+      cerr << "Usage: micro_bench [-corpus dir] [-filter text] [-min_time s]"
+           << endl;
+      cerr << " -ex key1 value1 ... (solver options for the capture run)"
+           << endl;
+      return 1;
+    }
+  }
+  parameter.extra_parameter["answer_files"] = "0";
+
+  // one context per problem, as the fixtures of all problems live together.
+  vector<unique_ptr<SolverContext>> contexts;
+  vector<vector<Fixture>> fixtures;
+  MicroBench bench(min_time, filter);
+  for (auto &name : ProblemReader::list(corpus)) {
+    // no capture solve for a problem the filter leaves no benchmark of.
+    bool wanted = false;
+    for (const char *body : kBodies) {
+      for (int percent : kPercents) {
+        wanted |= bench.matches(string(body) + "/" + name + "/" +
+                                to_string(percent));
+      }
+    }
+    if (!wanted) continue;
+    const auto problem = ProblemReader().read(corpus + "/" + name + ".txt");
+    SolverAnswer answer;
+    ifstream planted(corpus + "/" + name + ".ans");
+    if (planted) {
+      answer = SolverAnswerReader::read(planted, problem);
+    } else {
+      cerr << "[micro] solving " << name << endl;
+      answer = Solver(problem, parameter).run();
+    }
+
+    contexts.emplace_back(new SolverContext);
+    g = contexts.back().get();
+    g->init(problem);
+    fixtures.emplace_back();
+    for (int percent : kPercents) {
+      Fixture f;
+      f.name = name + "/" + to_string(percent);
+      f.state = replay(answer, answer.put_list.size() * percent / 100);
+      const auto pos = SampleSolver::getNextTargetPos(*f.state);
+      if (pos.empty()) {
+        GameState::free(f.state);
+        continue;
+      }
+      f.pos = pos[0];
+      for (int id = 0; id < (int)problem.stone_list.size(); ++id) {
+        if (f.state->isUsed(id)) continue;
+        for (int r = 0; r < 8; ++r) {
+          if (g->stone_pattern_vector[id][r].empty()) continue;
+          f.candidate.emplace_back(id, f.pos.x, f.pos.y, r);
+        }
+      }
+      f.available = f.state->getAvailableList(f.pos.x, f.pos.y);
+      if (f.candidate.empty() || f.available.empty()) {
+        GameState::free(f.state);
+        continue;
+      }
+      fixtures.back().push_back(f);
+    }
+  }
+  for (size_t i = 0; i < fixtures.size(); ++i) {
+    addFixtures(bench, contexts[i].get(), fixtures[i]);
+  }
+  bench.run();
+  return 0;
+}
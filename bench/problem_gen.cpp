@@ -0,0 +1,329 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2015 Shingo INADA
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+// Generates a problem together with a perfect answer. The free cells of the
+// board are cut into polyominoes that fit the 8x8 stone box, and the stones
+// are numbered in growth order, so every stone touches an earlier one and
+// the planted answer leaves no empty cell.
+
+#include <algorithm>
+#include <iostream>
+#include <map>
+#include <queue>
+#include <random>
+#include <string>
+#include <vector>
+#include "common.hpp"
+
+using namespace std;
+
+static const int dx[] = {1, 0, -1, 0};
+static const int dy[] = {0, 1, 0, -1};
+
+struct Cell {
+  int x, y;
+};
+
+class ProblemGenerator {
+ public:
+  ProblemGenerator(map<string, string> option) : option_(option) {
+    rng_.seed(stoi(get("seed", "1")));
+    min_cells_ = max(1, stoi(get("min_cells", "4")));
+    max_cells_ = min(16, max(min_cells_, stoi(get("max_cells", "16"))));
+  }
+
+  // fills problem and answer, false if the pieces do not fit in 256 stones.
+  bool generate(Problem &problem, SolverAnswer &answer) {
+    makeField();
+    keepLargestArea();
+    cutPieces();
+    if (pieces_.empty()) {
+      cerr << "no free cell left, lower density." << endl;
+      return false;
+    }
+    const int decoys = stoi(get("decoys", "0"));
+    if (pieces_.size() + decoys > 256) {
+      cerr << pieces_.size() << " pieces and " << decoys
+           << " decoys exceed 256 stones, raise min_cells." << endl;
+      return false;
+    }
+
+    // decoy stones are spread between the planted ones and never used.
+    vector<int> order(pieces_.size(), 0);
+    order.insert(order.end(), decoys, 1);
+    shuffle(order.begin() + 1, order.end(), rng_);
+
+    problem.field = vector<vector<int>>(32, vector<int>(32));
+    for (int y = 0; y < 32; ++y)
+      for (int x = 0; x < 32; ++x) problem.field[y][x] = field_[y][x];
+    problem.stone_list.clear();
+    SolverAnswerBuilder builder(
+        Problem{problem.field, vector<vector<vector<int>>>(order.size())});
+    size_t next_piece = 0;
+    for (int kind : order) {
+      const int id = problem.stone_list.size();
+      if (kind == 1) {
+        problem.stone_list.push_back(decoyStone());
+      } else {
+        problem.stone_list.push_back(plantStone(pieces_[next_piece++], id,
+                                                builder));
+      }
+    }
+    answer = builder.build();
+    return true;
+  }
+
+ private:
+  string get(const string &key, const string &value) const {
+    auto it = option_.find(key);
+    return it == option_.end() ? value : it->second;
+  }
+
+  void makeField() {
+    const string shape = get("shape", "random");
+    const double density = stod(get("density", "0.05"));
+    uniform_real_distribution<double> unit(0, 1);
+    for (int y = 0; y < 32; ++y)
+      for (int x = 0; x < 32; ++x) field_[y][x] = unit(rng_) < density;
+
+    if (shape == "spiral") {
+      // a one-cell wall winding inwards with a two-cell corridor.
+      int x = 1, y = 1, d = 0, len = 30;
+      for (int seg = 0; len > 0; ++seg) {
+        for (int i = 0; i < len; ++i) {
+          field_[y][x] = 1;
+          if (i + 1 < len) x += dx[d], y += dy[d];
+        }
+        d = (d + 1) % 4;
+        x += dx[d], y += dy[d];
+        if (seg >= 1 && seg % 2 == 1) len -= 3;
+      }
+    } else if (shape == "blocks") {
+      uniform_int_distribution<int> pos(0, 31), size(2, 6), count(4, 10);
+      for (int n = count(rng_); n--;) {
+        const int x0 = pos(rng_), y0 = pos(rng_), w = size(rng_),
+                  h = size(rng_);
+        for (int y = y0; y < min(32, y0 + h); ++y)
+          for (int x = x0; x < min(32, x0 + w); ++x) field_[y][x] = 1;
+      }
+    } else if (shape != "random") {
+      cerr << "unknown shape " << shape << ", using random." << endl;
+    }
+  }
+
+  // stones must touch each other, so only one connected area can be
+  // covered; the rest becomes obstacles.
+  void keepLargestArea() {
+    int area[32][32];
+    for (auto &row : area) fill(row, row + 32, -1);
+    vector<int> sizes;
+    for (int y = 0; y < 32; ++y) {
+      for (int x = 0; x < 32; ++x) {
+        if (field_[y][x] || area[y][x] >= 0) continue;
+        const int id = sizes.size();
+        sizes.push_back(0);
+        queue<Cell> q;
+        q.push({x, y});
+        area[y][x] = id;
+        while (!q.empty()) {
+          const Cell c = q.front();
+          q.pop();
+          sizes[id]++;
+          for (int r = 0; r < 4; ++r) {
+            const int nx = c.x + dx[r], ny = c.y + dy[r];
+            if (inside(nx, ny) && !field_[ny][nx] && area[ny][nx] < 0) {
+              area[ny][nx] = id;
+              q.push({nx, ny});
+            }
+          }
+        }
+      }
+    }
+    const int best = max_element(sizes.begin(), sizes.end()) - sizes.begin();
+    for (int y = 0; y < 32; ++y)
+      for (int x = 0; x < 32; ++x)
+        if (!field_[y][x] && area[y][x] != best) field_[y][x] = 1;
+  }
+
+  // each piece grows from a free cell next to an earlier piece, so the
+  // pieces are already in a valid placement order.
+  void cutPieces() {
+    int owner[32][32];
+    for (auto &row : owner) fill(row, row + 32, -1);
+    vector<Cell> free_cells;
+    for (int y = 0; y < 32; ++y)
+      for (int x = 0; x < 32; ++x)
+        if (!field_[y][x]) free_cells.push_back({x, y});
+    if (free_cells.empty()) return;
+
+    uniform_int_distribution<int> target(min_cells_, max_cells_);
+    Cell seed = free_cells[rng_() % free_cells.size()];
+    for (;;) {
+      const int id = pieces_.size();
+      vector<Cell> piece = {seed};
+      owner[seed.y][seed.x] = id;
+      for (int want = target(rng_); (int)piece.size() < want;) {
+        vector<Cell> frontier;
+        for (const Cell &c : piece) {
+          for (int r = 0; r < 4; ++r) {
+            const Cell n = {c.x + dx[r], c.y + dy[r]};
+            if (isFree(n, owner) && fitsBox(piece, n)) frontier.push_back(n);
+          }
+        }
+        if (frontier.empty()) break;
+        const Cell n = frontier[rng_() % frontier.size()];
+        owner[n.y][n.x] = id;
+        piece.push_back(n);
+      }
+      pieces_.push_back(piece);
+
+      vector<Cell> next;
+      for (const Cell &c : free_cells) {
+        if (owner[c.y][c.x] >= 0) continue;
+        for (int r = 0; r < 4; ++r) {
+          const int nx = c.x + dx[r], ny = c.y + dy[r];
+          if (inside(nx, ny) && owner[ny][nx] >= 0) {
+            next.push_back(c);
+            break;
+          }
+        }
+      }
+      if (next.empty()) return;
+      seed = next[rng_() % next.size()];
+    }
+  }
+
+  // the stone, in a random orientation, whose flip and rotation give back
+  // the piece. flip is x -> 7 - x, then each rotation (x, y) -> (7 - y, x).
+  vector<vector<int>> plantStone(const vector<Cell> &piece, int id,
+                                 SolverAnswerBuilder &builder) {
+    const int flip = rng_() % 2, rotate = rng_() % 4;
+    int min_x = 32, min_y = 32;
+    for (const Cell &c : piece) min_x = min(min_x, c.x), min_y = min(min_y, c.y);
+
+    // undo the rotations and the flip on the piece moved to the box origin.
+    vector<Cell> stone;
+    for (const Cell &c : piece) {
+      Cell s = {c.x - min_x, c.y - min_y};
+      for (int r = 0; r < rotate; ++r) s = {s.y, 7 - s.x};
+      if (flip) s.x = 7 - s.x;
+      stone.push_back(s);
+    }
+    // then shift it anywhere inside the box.
+    int lo_x = 8, lo_y = 8, hi_x = -1, hi_y = -1;
+    for (const Cell &s : stone) {
+      lo_x = min(lo_x, s.x), hi_x = max(hi_x, s.x);
+      lo_y = min(lo_y, s.y), hi_y = max(hi_y, s.y);
+    }
+    const int sx = (int)(rng_() % (8 - (hi_x - lo_x))) - lo_x;
+    const int sy = (int)(rng_() % (8 - (hi_y - lo_y))) - lo_y;
+    vector<vector<int>> pattern(8, vector<int>(8));
+    for (Cell &s : stone) {
+      s.x += sx, s.y += sy;
+      pattern[s.y][s.x] = 1;
+    }
+
+    // where the transformed stone's cells land decides the put position.
+    int t_x = 8, t_y = 8;
+    for (Cell s : stone) {
+      if (flip) s.x = 7 - s.x;
+      for (int r = 0; r < rotate; ++r) s = {7 - s.y, s.x};
+      t_x = min(t_x, s.x), t_y = min(t_y, s.y);
+    }
+    builder.put(id, min_x - t_x, min_y - t_y, flip, rotate);
+    return pattern;
+  }
+
+  vector<vector<int>> decoyStone() {
+    vector<Cell> cells = {{(int)(rng_() % 8), (int)(rng_() % 8)}};
+    vector<vector<int>> pattern(8, vector<int>(8));
+    pattern[cells[0].y][cells[0].x] = 1;
+    uniform_int_distribution<int> target(min_cells_, max_cells_);
+    for (int want = target(rng_), tries = 0;
+         (int)cells.size() < want && tries < 1000; ++tries) {
+      const Cell &c = cells[rng_() % cells.size()];
+      const int r = rng_() % 4;
+      const int nx = c.x + dx[r], ny = c.y + dy[r];
+      if (nx < 0 || nx >= 8 || ny < 0 || ny >= 8 || pattern[ny][nx]) continue;
+      pattern[ny][nx] = 1;
+      cells.push_back({nx, ny});
+    }
+    return pattern;
+  }
+
+  static bool inside(int x, int y) {
+    return x >= 0 && x < 32 && y >= 0 && y < 32;
+  }
+
+  bool isFree(const Cell &c, int owner[32][32]) const {
+    return inside(c.x, c.y) && !field_[c.y][c.x] && owner[c.y][c.x] < 0;
+  }
+
+  static bool fitsBox(const vector<Cell> &piece, const Cell &n) {
+    int lo_x = n.x, hi_x = n.x, lo_y = n.y, hi_y = n.y;
+    for (const Cell &c : piece) {
+      lo_x = min(lo_x, c.x), hi_x = max(hi_x, c.x);
+      lo_y = min(lo_y, c.y), hi_y = max(hi_y, c.y);
+    }
+    return hi_x - lo_x < 8 && hi_y - lo_y < 8;
+  }
+
+  map<string, string> option_;
+  mt19937 rng_;
+  int min_cells_, max_cells_;
+  int field_[32][32];
+  vector<vector<Cell>> pieces_;
+};
+
+int main(int argc, char *argv[]) {
+  string output;
+  map<string, string> option;
+  for (int i = 1; i < argc; ++i) {
+    const string arg = argv[i];
+    if (arg == "-o" && i + 1 < argc) {
+      output = argv[++i];
+    } else if (arg == "-ex") {
+      for (++i; i + 1 < argc; i += 2) option[argv[i]] = argv[i + 1];
+    } else {
+      output.clear();
+      break;
+    }
+  }
+  if (output.empty()) {
+    cerr << "Usage: problem_gen -o name <options>" << endl;
+    cerr << " writes name.txt (problem) and name.ans (perfect answer)" << endl;
+    cerr << " -ex seed 1 shape random|spiral|blocks density 0.05" << endl;
+    cerr << "     min_cells 4 max_cells 16 decoys 0 (optinal)" << endl;
+    return 1;
+  }
+
+  Problem problem;
+  SolverAnswer answer;
+  if (!ProblemGenerator(option).generate(problem, answer)) return 1;
+  ProblemWriter(problem).write(output + ".txt");
+  SolverAnswerWriter(problem, answer).write(output + ".ans");
+  cerr << "[gen] " << answer.put_list.size() << " planted stones, "
+       << problem.stone_list.size() << " stones" << endl;
+  return 0;
+}
@@ -24,6 +24,10 @@
 cd $(dirname $0)
 find include \( -name \*.c -o -name \*.cpp -o -name \*.h -o -name \*.hpp \) \
   -exec clang-format -i {} \;
+find src \( -name \*.c -o -name \*.cpp -o -name \*.h -o -name \*.hpp \) \
+  -exec clang-format -i {} \;
+find bench fuzz \( -name \*.c -o -name \*.cpp -o -name \*.h -o -name \*.hpp \) \
+  -exec clang-format -i {} \;
 find main \( -name \*.c -o -name \*.cpp -o -name \*.h -o -name \*.hpp \) \
   -exec clang-format -i {} \;
 
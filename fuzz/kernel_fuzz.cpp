@@ -0,0 +1,387 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2015 Shingo INADA
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+// Differential fuzzer for the board kernels. Random put/undo sequences on
+// random problems drive GameState and a plain cell-array reference side by
+// side, and every step compares available, getAvailableList, the hash, the
+// empty count and toAnswer(). A rewritten kernel must keep this silent
+// before it is switched on.
+
+#include <algorithm>
+#include <array>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+#include "sample_solver.hpp"
+
+using namespace std;
+
+// today's semantics written as directly as possible, one cell at a time.
+// The board and the stone orientations are rebuilt from the raw problem, so
+// none of SolverContext's tables (default_field, stone_pattern_vector, the
+// masks) is shared with the kernel under test; only the board frame mapping
+// of Transform is.
+class ReferenceBoard {
+ public:
+  ReferenceBoard(const Problem &problem, int trans)
+      : trans_(trans), used_(256) {
+    for (int y = 0; y < 32; ++y) {
+      for (int x = 0; x < 32; ++x) {
+        const auto q = Transform::trans(trans, 0, x, y);
+        cell_[y][x] = problem.field[q.y][q.x] ? kBlock : kEmpty;
+      }
+    }
+    for (const auto &stone : problem.stone_list) {
+      pattern_.push_back(orientations(stone));
+    }
+  }
+
+  // every cell of the stone free and inside; unless it is the first stone,
+  // a 4-neighbour of the origin cell holds a lower numbered stone.
+  bool available(const Put &put) const {
+    if (put.id >= pattern_.size() || used_[put.id]) return false;
+    const auto &stone = pattern_[put.id][put.r];
+    if (stone.empty()) return false;
+    for (const auto &pos : stone) {
+      const int x = put.x + pos.x, y = put.y + pos.y;
+      if (!inside(x, y) || cell_[y][x] != kEmpty) return false;
+    }
+    if (placed_ == 0) return true;
+    for (int r = 0; r < 4; ++r) {
+      const int x = put.x + dx[r], y = put.y + dy[r];
+      if (inside(x, y) && cell_[y][x] >= 0 && cell_[y][x] < put.id) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  vector<Put> availableList(int x, int y) const {
+    vector<Put> ret;
+    for (int i = 0; i < 256 * 8; ++i) {
+      const Put put(i / 8, x, y, i % 8);
+      if (available(put)) ret.push_back(put);
+    }
+    return ret;
+  }
+
+  void put(const Put &put) {
+    for (const auto &pos : pattern_[put.id][put.r]) {
+      cell_[put.y + pos.y][put.x + pos.x] = put.id;
+    }
+    used_[put.id] = true;
+    placed_++;
+  }
+
+  void undo(const Put &put) {
+    for (const auto &pos : pattern_[put.id][put.r]) {
+      cell_[put.y + pos.y][put.x + pos.x] = kEmpty;
+    }
+    used_[put.id] = false;
+    placed_--;
+  }
+
+  // xor of the hash of every stone cell, in the untransformed frame.
+  uint32_t hash() const {
+    uint32_t h = 0;
+    for (int y = 0; y < 32; ++y) {
+      for (int x = 0; x < 32; ++x) {
+        if (cell_[y][x] < 0) continue;
+        const auto q = Transform::trans(trans_, 0, x, y);
+        h ^= FieldHash::get(q.x, q.y, (int)pattern_[cell_[y][x]][0].size());
+      }
+    }
+    return h;
+  }
+
+  int emptyCount() const {
+    int n = 0;
+    for (int y = 0; y < 32; ++y)
+      for (int x = 0; x < 32; ++x) n += cell_[y][x] == kEmpty;
+    return n;
+  }
+
+  // stone id per cell of the untransformed board, -1 elsewhere.
+  vector<int> occupancy() const {
+    vector<int> occ(32 * 32, -1);
+    for (int y = 0; y < 32; ++y) {
+      for (int x = 0; x < 32; ++x) {
+        if (cell_[y][x] < 0) continue;
+        occ[Transform::trans(trans_, 0, x, y).to1d()] = cell_[y][x];
+      }
+    }
+    return occ;
+  }
+
+  static bool inside(int x, int y) {
+    return x >= 0 && x < 32 && y >= 0 && y < 32;
+  }
+
+ private:
+  typedef array<vector<Point>, 8> Orientations;
+
+  // orientation r of a raw stone: flipped (x -> 7 - x) when r >= 4, then
+  // r % 4 turns of (x, y) -> (7 - y, x). The cells are offsets from the
+  // first cell in row-major order, which is where a Put places the stone.
+  // An orientation covering the same cells as an earlier one stays empty,
+  // as the solver never offers it.
+  static Orientations orientations(const vector<vector<int>> &stone) {
+    Orientations ret;
+    vector<vector<Point>> seen;
+    for (int r = 0; r < 8; ++r) {
+      bool cell[8][8] = {{false}};
+      for (int y = 0; y < 8; ++y) {
+        for (int x = 0; x < 8; ++x) {
+          if (!stone[y][x]) continue;
+          int tx = r >= 4 ? 7 - x : x, ty = y;
+          for (int k = 0; k < r % 4; ++k) {
+            const int t = tx;
+            tx = 7 - ty;
+            ty = t;
+          }
+          cell[ty][tx] = true;
+        }
+      }
+      vector<Point> offsets;
+      int ox = -1, oy = -1;
+      for (int y = 0; y < 8; ++y) {
+        for (int x = 0; x < 8; ++x) {
+          if (!cell[y][x]) continue;
+          if (ox < 0) ox = x, oy = y;
+          offsets.push_back(Point(x - ox, y - oy));
+        }
+      }
+      if (find(seen.begin(), seen.end(), offsets) != seen.end()) continue;
+      seen.push_back(offsets);
+      ret[r] = offsets;
+    }
+    return ret;
+  }
+
+  static const int kBlock = -1;
+  static const int kEmpty = -2;
+  int trans_;
+  int cell_[32][32];
+  vector<Orientations> pattern_;
+  vector<bool> used_;
+  int placed_ = 0;
+};
+
+// cells an answer covers, using the contest transform of the raw stones:
+// flip is x -> 7 - x, then each rotation (x, y) -> (7 - y, x).
+static vector<int> answerOccupancy(const Problem &problem,
+                                   const SolverAnswer &answer) {
+  vector<int> occ(32 * 32, -1);
+  for (const auto &a : answer.put_list) {
+    const auto &stone = problem.stone_list[a.stone_index];
+    for (int y = 0; y < 8; ++y) {
+      for (int x = 0; x < 8; ++x) {
+        if (!stone[y][x]) continue;
+        int tx = a.flip ? 7 - x : x, ty = y;
+        for (int r = 0; r < a.rotate; ++r) {
+          const int t = tx;
+          tx = 7 - ty;
+          ty = t;
+        }
+        tx += a.x;
+        ty += a.y;
+        if (!ReferenceBoard::inside(tx, ty)) return {};
+        occ[ty << 5 | tx] = a.stone_index;
+      }
+    }
+  }
+  return occ;
+}
+
+static Problem randomProblem(mt19937 &rng) {
+  Problem problem;
+  const double density = uniform_real_distribution<double>(0, 0.3)(rng);
+  uniform_real_distribution<double> unit(0, 1);
+  problem.field = vector<vector<int>>(32, vector<int>(32));
+  for (auto &row : problem.field)
+    for (auto &v : row) v = unit(rng) < density;
+  const int n = uniform_int_distribution<int>(1, 64)(rng);
+  for (int i = 0; i < n; ++i) {
+    vector<vector<int>> stone(8, vector<int>(8));
+    int x = rng() % 8, y = rng() % 8;
+    stone[y][x] = 1;
+    for (int k = rng() % 16; k > 0; --k) {
+      const int r = rng() % 4;
+      if (x + dx[r] >= 0 && x + dx[r] < 8 && y + dy[r] >= 0 && y + dy[r] < 8) {
+        x += dx[r];
+        y += dy[r];
+        stone[y][x] = 1;
+      }
+    }
+    problem.stone_list.push_back(stone);
+  }
+  return problem;
+}
+
+class KernelFuzzer {
+ public:
+  KernelFuzzer(unsigned seed, int steps) : seed_(seed), steps_(steps) {
+    rng_.seed(seed);
+  }
+
+  // false and a report on stderr at the first disagreement.
+  bool run() {
+    problem_ = randomProblem(rng_);
+    context_.reset(new SolverContext);
+    g = context_.get();
+    g->init(problem_);
+    trans_ = rng_() % 8;
+    state_ = GameState::alloc()->init();
+    state_->trans(trans_);
+    ReferenceBoard ref(problem_, trans_);
+    ref_ = &ref;
+    vector<Put> log;
+
+    bool ok = compare("init");
+    for (step_ = 0; ok && step_ < steps_; ++step_) {
+      if (!log.empty() && rng_() % 8 == 0) {
+        state_->undo(log.back());
+        ref.undo(log.back());
+        log.pop_back();
+        ok = compare("undo");
+        continue;
+      }
+      // the solver's own target first, then empty cells next to a stone in
+      // random order, until one of them takes a stone.
+      auto candidates = SampleSolver::getNextTargetPos(*state_);
+      vector<Point> frontier;
+      for (int y = 0; y < 32; ++y) {
+        for (int x = 0; x < 32; ++x) {
+          if (!state_->isEmpty(x, y)) continue;
+          bool touch = log.empty();
+          for (int r = 0; r < 4; ++r) {
+            const int nx = x + dx[r], ny = y + dy[r];
+            touch |= isInsideField(nx, ny) && state_->isStone(nx, ny);
+          }
+          if (touch) frontier.push_back(Point(x, y));
+        }
+      }
+      shuffle(frontier.begin(), frontier.end(), rng_);
+      candidates.insert(candidates.end(), frontier.begin(),
+                        frontier.begin() + min<size_t>(frontier.size(), 16));
+      vector<Put> got;
+      for (const auto &pos : candidates) {
+        got = state_->getAvailableList(pos.x, pos.y);
+        const auto want = ref.availableList(pos.x, pos.y);
+        if (!samePuts(got, want)) {
+          ok = fail("getAvailableList", pos, got.size(), want.size());
+          break;
+        }
+        if (!got.empty()) break;
+      }
+      for (int i = 0; i < 16 && ok; ++i) {
+        const Put put(rng_() % problem_.stone_list.size(),
+                      (int)(rng_() % 40) - 4, (int)(rng_() % 40) - 4,
+                      rng_() % 8);
+        if (put.x < 0 || put.y < 0 || put.x >= 32 || put.y >= 32) continue;
+        if (state_->available(put) != ref.available(put)) {
+          ok = fail("available", Point(put.x, put.y), state_->available(put),
+                    ref.available(put));
+        }
+      }
+      if (!ok || got.empty()) continue;
+      const Put put = got[rng_() % got.size()];
+      state_->put(put);
+      ref.put(put);
+      log.push_back(put);
+      ok = compare("put");
+    }
+    GameState::free(state_);
+    return ok;
+  }
+
+ private:
+  static bool samePuts(const vector<Put> &a, const vector<Put> &b) {
+    if (a.size() != b.size()) return false;
+    for (size_t i = 0; i < a.size(); ++i) {
+      if (a[i].value != b[i].value) return false;
+    }
+    return true;
+  }
+
+  bool compare(const char *what) {
+    if (state_->getHash() != ref_->hash()) {
+      return fail(string(what) + " hash", Point(0, 0), state_->getHash(),
+                  ref_->hash());
+    }
+    if (state_->getEmptyCount() != ref_->emptyCount()) {
+      return fail(string(what) + " empty count", Point(0, 0),
+                  state_->getEmptyCount(), ref_->emptyCount());
+    }
+    if (step_ % 8 == 0 &&
+        answerOccupancy(problem_, state_->toAnswer()) != ref_->occupancy()) {
+      return fail(string(what) + " toAnswer", Point(0, 0), 0, 0);
+    }
+    return true;
+  }
+
+  bool fail(const string &what, Point pos, long long got, long long want) {
+    cerr << "[fuzz] mismatch in " << what << " seed " << seed_ << " step "
+         << step_ << " trans " << trans_ << " at " << (int)pos.x << " "
+         << (int)pos.y << ": got " << got << " want " << want << endl;
+    return false;
+  }
+
+  unsigned seed_;
+  int steps_;
+  int step_ = 0;
+  int trans_ = 0;
+  mt19937 rng_;
+  Problem problem_;
+  unique_ptr<SolverContext> context_;
+  GameState *state_ = nullptr;
+  ReferenceBoard *ref_ = nullptr;
+};
+
+int main(int argc, char *argv[]) {
+  unsigned seed = 1;
+  int cases = 200, steps = 300;
+  map<string, string> option;
+  for (int i = 1; i < argc; ++i) {
+    if (string(argv[i]) == "-ex") {
+      for (++i; i + 1 < argc; i += 2) option[argv[i]] = argv[i + 1];
+    } else {
+      cerr << "Usage: kernel_fuzz -ex seed 1 cases 200 steps 300 (optinal)"
+           << endl;
+      return 1;
+    }
+  }
+  if (option.count("seed")) seed = stoul(option["seed"]);
+  if (option.count("cases")) cases = stoi(option["cases"]);
+  if (option.count("steps")) steps = stoi(option["steps"]);
+  for (int c = 0; c < cases; ++c) {
+    if (!KernelFuzzer(seed + c, steps).run()) return 1;
+  }
+  cerr << "[fuzz] " << cases << " cases of " << steps << " steps from seed "
+       << seed << " agree" << endl;
+  return 0;
+}
@@ -24,22 +24,55 @@ THE SOFTWARE.
 
 #pragma once
 
+#include <algorithm>
+#include <iostream>
 #include <vector>
 #include <string>
 #include <map>
 #include <fstream>
+#include <sstream>
 #include <array>
 #include <cassert>
+#include <cstdint>
+#include <functional>
+#include <stdexcept>
+#include <dirent.h>
+
+// a file one solve needs (seed, checkpoint, spill, stats) could not be
+// read or written. Solver::run throws it so that a batch or a daemon only
+// loses that problem.
+class SolverError : public std::runtime_error {
+ public:
+  using std::runtime_error::runtime_error;
+};
 
 struct SolverParameter {
   std::string problem_file;
   std::string answer_file;
+  std::string batch_file;
+  std::string daemon_socket;
   std::map<std::string, std::string> extra_parameter;
 };
 
 struct Problem {
   std::vector<std::vector<int>> field;
   std::vector<std::vector<std::vector<int>>> stone_list;
+
+  // FNV-1a over the field and the stones, identifies a problem on disk.
+  uint64_t hash() const {
+    uint64_t h = 14695981039346656037ULL;
+    auto mix = [&h](int v) {
+      h ^= static_cast<uint64_t>(v);
+      h *= 1099511628211ULL;
+    };
+    for (const auto &row : field)
+      for (int v : row) mix(v);
+    mix(static_cast<int>(stone_list.size()));
+    for (const auto &stone : stone_list)
+      for (const auto &row : stone)
+        for (int v : row) mix(v);
+    return h;
+  }
 };
 
 struct SolverAnswer {
@@ -51,6 +84,23 @@ struct SolverAnswer {
   std::vector<Put> put_list;
 };
 
+// a new best state during the search. answer() builds its SolverAnswer and
+// may only be called while the progress callback runs.
+struct SolverProgress {
+  int empty;
+  int stones;
+  double elapsed;  // seconds since run() started
+  std::function<SolverAnswer()> answer;
+};
+
+// totals of a finished run.
+struct SolverStats {
+  size_t expanded = 0;         // states expanded by the beam searches
+  double search_seconds = 0;  // time spent in the beam searches
+  int empty = 1024;           // empty cells of the returned answer
+  int stones = 0;             // stones used by the returned answer
+};
+
 class SolverParameterParser {
  public:
   SolverParameter parse(int argc, char *argv[]) {
@@ -67,6 +117,10 @@ class SolverParameterParser {
           param.problem_file = argv[++i];
         } else if (arg == "-o") {
           param.answer_file = argv[++i];
+        } else if (arg == "-batch") {
+          param.batch_file = argv[++i];
+        } else if (arg == "-daemon") {
+          param.daemon_socket = argv[++i];
         } else if (arg == "-ex") {
           extra = true;
         }
@@ -75,7 +129,8 @@ class SolverParameterParser {
         i++;
       }
     }
-    if (param.problem_file.empty()) {
+    if (param.problem_file.empty() && param.batch_file.empty() &&
+        param.daemon_socket.empty()) {
       printHelp();
       exit(1);
     }
@@ -87,33 +142,67 @@ class SolverParameterParser {
     std::cerr << "Usage: solver <options>" << std::endl;
     std::cerr << " -i problem_path" << std::endl;
     std::cerr << " -o problem_path (optional)" << std::endl;
+    std::cerr << " -batch problem_list (instead of -i)" << std::endl;
+    std::cerr << " -daemon socket_path|- (instead of -i)" << std::endl;
     std::cerr << " -ex key1 value1 key2 value2 ... (optinal)" << std::endl;
   }
 };
 
 class ProblemReader {
  public:
-  static Problem read(std::istream &is) {
-    Problem problem;
+  // checks the shape as it reads: 32 rows of 32 '0'/'1', a stone count of
+  // 1..256 (stone ids are one byte) and that many 8x8 stones with at least
+  // one cell each. On bad input `error` says what and false is returned.
+  static bool parse(std::istream &is, Problem &problem, std::string &error) {
+    auto row = [&is](std::string &s, size_t width) {
+      return is >> s && s.size() == width &&
+             s.find_first_not_of("01") == std::string::npos;
+    };
     problem.field = std::vector<std::vector<int>>(32, std::vector<int>(32));
     std::string s;
     for (int y = 0; y < 32; ++y) {
-      is >> s;
+      if (!row(s, 32)) {
+        error = "board row " + std::to_string(y + 1) + " is not 32 0/1";
+        return false;
+      }
       for (int x = 0; x < 32; ++x) {
         problem.field[y][x] = s[x] == '1';
       }
     }
     int n;
-    is >> n;
+    if (!(is >> n) || n < 1 || n > 256) {
+      error = "the stone count must be 1..256";
+      return false;
+    }
     problem.stone_list = std::vector<std::vector<std::vector<int>>>(
         n, std::vector<std::vector<int>>(8, std::vector<int>(8)));
     for (int i = 0; i < n; ++i) {
+      int cells = 0;
       for (int y = 0; y < 8; ++y) {
-        is >> s;
+        if (!row(s, 8)) {
+          error = "stone " + std::to_string(i) + " row " +
+                  std::to_string(y + 1) + " is not 8 0/1";
+          return false;
+        }
         for (int x = 0; x < 8; ++x) {
           problem.stone_list[i][y][x] = s[x] == '1';
+          cells += s[x] == '1';
         }
       }
+      if (!cells) {
+        error = "stone " + std::to_string(i) + " is empty";
+        return false;
+      }
+    }
+    return true;
+  }
+
+  static Problem read(std::istream &is) {
+    Problem problem;
+    std::string error;
+    if (!parse(is, problem, error)) {
+      std::cerr << "malformed problem, " << error << std::endl;
+      exit(1);
     }
     return std::move(problem);
   }
@@ -127,6 +216,59 @@ class ProblemReader {
     }
     return read(ifs);
   }
+
+  // the names of the *.txt problems in `dir` without the extension, sorted.
+  static std::vector<std::string> list(const std::string &dir) {
+    std::vector<std::string> names;
+    DIR *d = opendir(dir.c_str());
+    if (!d) {
+      std::cerr << "cannnot open the problem directory. " << dir << std::endl;
+      exit(1);
+    }
+    while (dirent *e = readdir(d)) {
+      const std::string name = e->d_name;
+      if (name.size() > 4 && name.substr(name.size() - 4) == ".txt") {
+        names.push_back(name.substr(0, name.size() - 4));
+      }
+    }
+    closedir(d);
+    std::sort(names.begin(), names.end());
+    return names;
+  }
+};
+
+class ProblemWriter {
+ public:
+  ProblemWriter(const Problem &problem) : problem_(problem) {}
+
+  void write(std::ostream &os = std::cout) {
+    for (const auto &row : problem_.field) {
+      for (int v : row) os << (v ? '1' : '0');
+      os << "\r\n";
+    }
+    os << "\r\n" << problem_.stone_list.size() << "\r\n";
+    for (const auto &stone : problem_.stone_list) {
+      os << "\r\n";
+      for (const auto &row : stone) {
+        for (int v : row) os << (v ? '1' : '0');
+        os << "\r\n";
+      }
+    }
+    os.flush();
+  }
+
+  void write(std::string problem_file) {
+    std::ofstream ofs(problem_file);
+    if (!ofs) {
+      std::cerr << "cannnot open the problem_file. " << problem_file
+                << std::endl;
+      exit(1);
+    }
+    write(ofs);
+  }
+
+ private:
+  const Problem &problem_;
 };
 
 class SolverAnswerBuilder {
@@ -155,6 +297,69 @@ class SolverAnswerBuilder {
   SolverAnswer answer_;
 };
 
+class SolverAnswerReader {
+ public:
+  // parses the SolverAnswerWriter format: one line per stone, blank when
+  // the stone is not used, otherwise "x y H|T degree" with degree one of
+  // 0, 90, 180, 270 and x, y in -7..31. Missing trailing lines are unused
+  // stones. On a malformed line `error` names it and false is returned.
+  static bool parse(std::istream &is, const Problem &problem,
+                    SolverAnswer &answer, std::string &error) {
+    SolverAnswerBuilder builder(problem);
+    std::string line;
+    for (int i = 0; std::getline(is, line); ++i) {
+      std::istringstream ls(line);
+      std::string rest;
+      if (!(ls >> rest)) continue;
+      auto fail = [&error, i](const std::string &what) {
+        error = "line " + std::to_string(i + 1) + ": " + what;
+        return false;
+      };
+      if (i >= (int)problem.stone_list.size()) return fail("no such stone");
+      ls.clear();
+      ls.seekg(0);
+      int x, y, degree;
+      std::string flip;
+      if (!(ls >> x >> y >> flip >> degree)) {
+        return fail("expected x y H|T degree");
+      }
+      if (ls >> rest) return fail("trailing text");
+      if (x < -7 || x >= 32 || y < -7 || y >= 32) {
+        return fail("position out of range");
+      }
+      if (flip != "H" && flip != "T") return fail("flip must be H or T");
+      if (degree != 0 && degree != 90 && degree != 180 && degree != 270) {
+        return fail("degree must be 0, 90, 180 or 270");
+      }
+      builder.put(i, x, y, flip == "T", degree / 90);
+    }
+    answer = builder.build();
+    return true;
+  }
+
+  // parse() that reports a malformed answer on stderr and reads it as
+  // placing no stones.
+  static SolverAnswer read(std::istream &is, const Problem &problem) {
+    SolverAnswer answer;
+    std::string error;
+    if (!parse(is, problem, answer, error)) {
+      std::cerr << "malformed answer, " << error << std::endl;
+      return SolverAnswer();
+    }
+    return answer;
+  }
+
+  SolverAnswer read(std::string answer_file, const Problem &problem) {
+    std::ifstream ifs(answer_file);
+    if (!ifs) {
+      std::cerr << "cannnot open the answer_file. " << answer_file
+                << std::endl;
+      exit(1);
+    }
+    return read(ifs, problem);
+  }
+};
+
 class SolverAnswerWriter {
  public:
   SolverAnswerWriter(const Problem &problem, const SolverAnswer &answer)
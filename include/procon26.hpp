@@ -0,0 +1,107 @@
+﻿/*
+The MIT License (MIT)
+
+Copyright (c) 2015 Shingo INADA
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#pragma once
+
+#include <chrono>
+#include <functional>
+#include <future>
+#include <memory>
+#include "common.hpp"
+
+// Result of replaying an answer under the contest rules.
+struct AnswerCheck {
+  bool valid = false;
+  int empty = 0;   // empty cells left, valid answers only
+  int stones = 0;  // stones placed, valid answers only
+  std::string error;
+};
+
+// Places the stones in index order: each one must lie inside the board on
+// free cells and, except the first, touch an earlier stone on an edge.
+// flip is x -> 7 - x, then each rotation (x, y) -> (7 - y, x).
+AnswerCheck verifyAnswer(const Problem &problem, const SolverAnswer &answer);
+
+// Embeddable solver. Every Solver owns its problem state and the GameState
+// pools are per thread, so several solvers can run at once on different
+// threads of one process.
+class Solver {
+  struct Impl;
+
+ public:
+  // parameter.extra_parameter takes the same keys as `solver -ex`.
+  Solver(const Problem &problem, const SolverParameter &parameter);
+  ~Solver();
+  Solver(const Solver &) = delete;
+  Solver &operator=(const Solver &) = delete;
+
+  // called on the solving thread whenever a better answer has been built,
+  // with its empty cell and stone counts.
+  void onAnswer(std::function<void(const SolverAnswer &, int, int)> callback);
+
+  // called on the solving thread on every best state improvement, and once
+  // before the search when -ex seed, cache or resume supplies an answer.
+  // Keep it cheap: it runs inside the beam search.
+  void onProgress(std::function<void(const SolverProgress &)> callback);
+
+  // search and return the best answer found.
+  SolverAnswer run();
+
+  // make run() return at the next bucket boundary; safe from any thread.
+  // The next run() or runAsync() starts uncancelled.
+  void cancel();
+
+  // totals of the last run(), valid once it has returned.
+  SolverStats stats() const;
+
+  // handle of a run() on its own thread. It keeps the solver alive, so it
+  // may outlive the Solver it came from.
+  class Async {
+   public:
+    // the best answer, blocks until the run has finished.
+    SolverAnswer get() const { return future_.get(); }
+    void wait() const { future_.wait(); }
+    template <class Rep, class Period>
+    bool waitFor(const std::chrono::duration<Rep, Period> &timeout) const {
+      return future_.wait_for(timeout) == std::future_status::ready;
+    }
+    bool ready() const { return waitFor(std::chrono::seconds(0)); }
+    void cancel();
+
+   private:
+    friend class Solver;
+    std::shared_ptr<Impl> impl_;
+    std::shared_future<SolverAnswer> future_;
+  };
+
+  // start run() on a new thread, whose state pool is released when the run
+  // ends. Set the callbacks before calling this.
+  Async runAsync();
+
+  // gv output (result.html) goes to one global file and is off by default.
+  static void setVisualization(bool enable);
+
+ private:
+  std::shared_ptr<Impl> impl_;
+};
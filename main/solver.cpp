@@ -23,866 +23,357 @@ THE SOFTWARE.
 */
 
 #include <algorithm>
-#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
 #include <fstream>
 #include <iostream>
-#include <iomanip>
-#include <set>
-#include <list>
+#include <mutex>
+#include <sstream>
 #include <string>
-#include <queue>
-#include <stack>
-#include <tuple>
+#include <thread>
 #include <vector>
-#include <cassert>
-#include <random>
-#include <google/dense_hash_map>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
 #include "common.hpp"
-#define GV_JS
-// #define DISABLE_GV
-#include "gv.hpp"
-
-#define DEBUG_MEMORY_CHECK
+#include "procon26.hpp"
 
 using namespace std;
 
-static const int dx[] = {1, 0, -1, 0};
-static const int dy[] = {0, 1, 0, -1};
-
-union Point {
-  uint16_t value;
-  struct {
-    char x;
-    char y;
-  };
-  Point() = default;
-  Point(char x, char y) : x(x), y(y) {}
-  Point operator+(const Point &o) const { return Point(x + o.x, y + o.y); }
-  Point operator-(const Point &o) const { return Point(x - o.x, y - o.y); }
-  bool operator==(const Point &o) const { return value == o.value; }
-  void operator+=(const Point &o) {
-    x += o.x;
-    y += o.y;
-  }
-  void operator-=(const Point &o) {
-    x -= o.x;
-    y -= o.y;
-  }
-  bool operator<(const Point &o) const { return y != o.y ? y < o.y : x < o.x; }
-  uint16_t to1d() const {
-    assert(y >= 0);
-    assert(x >= 0);
-    return y << 5 | x;
-  }
-  static Point from1d(uint16_t p) {
-    assert(!(p >> 10));
-    return Point(p & 0x1f, p >> 5);
-  }
-};
-
-struct Transform {
-  static array<array<array<array<uint16_t, 32>, 32>, 8>, 8> trans_table_;
-  static bool built;
-
- public:
-  static Point trans(int from, int to, Point a) {
-    assert(built);
-    assert(from >= 0 && from < 8);
-    assert(to >= 0 && to < 8);
-    return Point::from1d(trans_table_[from][to][a.y][a.x]);
-  }
-  static Point trans(int from, int to, int x, int y) {
-    assert(built);
-    assert(from >= 0 && from < 8);
-    assert(to >= 0 && to < 8);
-    return Point::from1d(trans_table_[from][to][y][x]);
-  }
-
-  static void build() {
-    if (built) return;
-    built = true;
-
-    array<array<uint16_t, 32>, 32> origin;
-    for (int y = 0; y < 32; ++y) {
-      for (int x = 0; x < 32; ++x) {
-        origin[y][x] = y << 5 | x;
-      }
-    }
-
-    auto flip = [](array<array<uint16_t, 32>, 32> f, bool x = true) {
-      if (x) {
-        for (int i = 0; i < 32; ++i) {
-          std::reverse(f[i].begin(), f[i].end());
-        }
-      } else {
-        for (int i = 0; i < 16; ++i) {
-          std::swap(f[i], f[31 - i]);
-        }
-      }
-      return std::move(f);
-    };
-
-    auto rotate90 = [flip](array<array<uint16_t, 32>, 32> f, bool plus = true) {
-      for (int i = 0; i < 32; ++i) {
-        for (int j = i; j < 32; ++j) {
-          std::swap(f[i][j], f[j][i]);
-        }
-      }
-      return std::move(flip(std::move(f), plus));
-    };
-
-    auto save = [](array<array<uint16_t, 32>, 32> f, int from, int to) {
-      Transform::trans_table_[from][to] = f;
-    };
-
-    for (int i = 0; i < 8; ++i) {
-      auto g = origin;
-      save(g, i, i);
-      for (int k = 1; k < 8; ++k) {
-        int j = (i + k) % 8;
-        g = rotate90(g);
-        if (j % 4 == 0) g = flip(g);
-        save(g, j, i);
-      }
+// -batch: solve every problem listed in the file (one path per line) on up
+// to `-ex jobs` worker threads, writing each answer to <problem>.ans. The
+// workers keep their GameState pools between problems. A problem whose
+// files cannot be read or written is reported and skipped; the exit status
+// is 1 if any was.
+int runBatch(const SolverParameter &parameter) {
+  for (const char *key : {"seed", "resume"}) {
+    if (parameter.extra_parameter.count(key)) {
+      cerr << "-ex " << key << " names one problem's file and cannot be used "
+           << "with -batch." << endl;
+      return 1;
     }
   }
-};
-array<array<array<array<uint16_t, 32>, 32>, 8>, 8> Transform::trans_table_;
-bool Transform::built = false;
-
-struct FieldHash {
-  static bool built;
-  static void build() {
-    built = true;
-    std::mt19937 mt;
-    // mt.seed(std::random_device()());
-    for (int i = 0; i < hash_table_.size(); ++i) {
-      hash_table_[i] = mt();
+  vector<string> files;
+  {
+    ifstream ifs(parameter.batch_file);
+    if (!ifs) {
+      cerr << "cannnot open the batch_file. " << parameter.batch_file << endl;
+      return 1;
     }
-  }
-  static uint32_t get(int x, int y, int s) {
-    assert(built);
-    assert(x >= 0 && x < 32);
-    assert(y >= 0 && y < 32);
-    assert(s >= 1 && s <= 16);
-    return hash_table_[y << 9 | x << 4 /*| (s - 1) */];
-  }
-
- private:
-  static array<uint32_t, 32 * 32 * 16> hash_table_;
-};
-bool FieldHash::built = false;
-array<uint32_t, 32 * 32 * 16> FieldHash::hash_table_;
-
-struct Field : public array<array<uint8_t, 32>, 32> {
-  Field() {
-    for (int i = 0; i < 32; ++i) (*this)[i].fill(0);
-  };
-
-  void transform(int from, int to) {
-    Field f;
-    for (int y = 0; y < 32; ++y) {
-      for (int x = 0; x < 32; ++x) {
-        auto p = Transform::trans(from, to, x, y);
-        f[p.y][p.x] = (*this)[y][x];
-      }
+    string line;
+    while (getline(ifs, line)) {
+      if (!line.empty() && line.back() == '\r') line.pop_back();
+      if (!line.empty()) files.push_back(line);
     }
-    *this = std::move(f);
-  }
-};
-
-struct BitField : public bitset<32 * 32> {
-  size_t hash() const {
-    static std::hash<bitset<32 * 32>> h;
-    return h(*this);
   }
-  void transform(int from, int to) {
-    BitField f;
-    for (int y = 0; y < 32; ++y) {
-      for (int x = 0; x < 32; ++x) {
-        auto p = Transform::trans(from, to, x, y);
-        f[p.to1d()] = (*this)[y << 5 | x];
+  int jobs = max(1u, thread::hardware_concurrency());
+  auto it = parameter.extra_parameter.find("jobs");
+  if (it != parameter.extra_parameter.end()) jobs = std::stoi(it->second);
+  jobs = max(1, min(jobs, (int)files.size()));
+
+  atomic<size_t> next(0);
+  atomic<int> failed(0);
+  mutex log_mutex;
+  auto worker = [&]() {
+    for (size_t i; (i = next++) < files.size();) {
+      SolverParameter p = parameter;
+      p.problem_file = files[i];
+      p.answer_file = files[i] + ".ans";
+      p.extra_parameter["answer_prefix"] = files[i] + ".";
+      if (p.extra_parameter.count("checkpoint")) {
+        p.extra_parameter["checkpoint"] = files[i] + ".ckpt";
       }
-    }
-    *this = std::move(f);
-  }
-};
-
-struct UsedMask : public bitset<256> {};
-
-struct {
-  vector<array<vector<Point>, 8>> stone_pattern_vector;
-  vector<array<Point, 8>> stone_pattern_origin;
-  array<array<bitset<256 * 8>, 16>, 8> stone_pattern_mask;
-  array<Field, 8> default_field;
-  int default_empty_count = 1024;
-  int total_complete_count = 0;
-  Problem problem;
-  size_t total_alloc_count = 0;
-  size_t total_free_count = 0;
-  int weight_diff_id = 5;
-
-  bool fix_ = false;
-  void init(Problem problem_) {
-    if (fix_) return;
-    fix_ = true;
-    problem = problem_;
-    Transform::build();
-    FieldHash::build();
-
-    for (int y = 0; y < 32; y++) {
-      for (int x = 0; x < 32; x++) {
-        default_field[0][y][x] = problem_.field[y][x];
-        if (problem_.field[y][x]) default_empty_count--;
+      if (p.extra_parameter.count("heartbeat")) {
+        p.extra_parameter["heartbeat"] = files[i] + ".heartbeat.json";
       }
-    }
-
-    for (int i = 1; i < 8; ++i) {
-      default_field[i] = default_field[0];
-      default_field[i].transform(0, i);
-    }
-
-    vector<array<array<bitset<8>, 8>, 8>> stone_pattern_list_;
-    stone_pattern_list_.resize(problem_.stone_list.size());
-    for (int i = 0; i < problem_.stone_list.size(); ++i) {
-      const auto &stone = problem_.stone_list[i];
-      for (int y = 0; y < 8; y++) {
-        for (int x = 0; x < 8; x++) {
-          if (stone[y][x]) {
-            stone_pattern_list_[i][0][y][x] = 1;
-            stone_pattern_list_[i][4][y][7 - x] = 1;
-          }
-        }
+      if (p.extra_parameter.count("stats")) {
+        const auto &stats = p.extra_parameter["stats"];
+        const auto dot = stats.rfind('.');
+        p.extra_parameter["stats"] =
+            files[i] + ".stats" +
+            (dot == string::npos ? string(".jsonl") : stats.substr(dot));
       }
-    }
-
-    for (int i = 0; i < problem_.stone_list.size(); ++i) {
-      for (int j = 1; j < 8; j++) {
-        if (j % 4 == 0) continue;
-        for (int y = 0; y < 8; y++) {
-          for (int x = 0; x < 8; x++) {
-            stone_pattern_list_[i][j][x][7 - y] =
-                stone_pattern_list_[i][j - 1][y][x];
-          }
-        }
+      const auto start = chrono::steady_clock::now();
+      ifstream ifs(p.problem_file);
+      Problem problem;
+      string error = "cannnot open the problem_file.";
+      if (!ifs || !ProblemReader::parse(ifs, problem, error)) {
+        lock_guard<mutex> lock(log_mutex);
+        cerr << "[batch] " << files[i] << " " << error << endl;
+        failed++;
+        continue;
       }
-    }
-
-    stone_pattern_vector.resize(problem_.stone_list.size());
-    stone_pattern_origin.resize(problem_.stone_list.size());
-    for (int i = 0; i < problem_.stone_list.size(); ++i) {
-      set<set<Point>> stone_vector_set;
-      for (int j = 0; j < 8; j++) {
-        set<Point> sample_vector;
-        sample_vector.emplace(0, 0);
-        bool found = false;
-        Point p(0, 0);
-        for (int y = 0; y < 8; y++) {
-          for (int x = 0; x < 8; x++) {
-            if (stone_pattern_list_[i][j][y][x]) {
-              Point q(x, y);
-              if (!found) {
-                p = q;
-                found = true;
-              } else {
-                sample_vector.emplace(q - p);
-              }
-            }
-          }
-        }
-
-        auto result = stone_vector_set.emplace(sample_vector);
-        if (result.second) {
-          stone_pattern_origin[i][j] = p;
-          for (const auto &p : sample_vector) {
-            assert(p.x > -8 && p.x < 8);
-            assert(p.y >= 0 && p.y < 8);
-            stone_pattern_vector[i][j].emplace_back(p.x, p.y);
-            stone_pattern_mask[p.y][p.x + 8][8 * i + j] = true;
-          }
-        } else {
-          for (int y = 0; y < 8; ++y) {
-            for (int x = 0; x < 16; ++x) {
-              stone_pattern_mask[y][x][8 * i + j] = true;
-            }
-          }
-        }
+      SolverAnswer answer;
+      try {
+        Solver solver(problem, p);
+        answer = solver.run();
+      } catch (const SolverError &e) {
+        lock_guard<mutex> lock(log_mutex);
+        cerr << "[batch] " << files[i] << " failed: " << e.what() << endl;
+        failed++;
+        continue;
       }
+      SolverAnswerWriter(problem, answer).write(p.answer_file);
+      const double sec = chrono::duration<double>(
+                             chrono::steady_clock::now() - start).count();
+      lock_guard<mutex> lock(log_mutex);
+      cerr << "[batch] " << files[i] << " stones " << answer.put_list.size()
+           << " " << sec << " s" << endl;
     }
-  }
-} g;
-
-template <class T>
-bool isInsideField(T x, T y) {
-  return !(x >> 5 | y >> 5);
-}
-
-template <class T>
-bool isInsideField(const T &p) {
-  return isInsideField(p.x, p.y);
-}
-
-union Put {
-  uint32_t value;
-  struct {
-    u_char id;
-    char y;
-    char x;
-    char r;
   };
-  Put(u_char id, char x, char y, char r) : id(id), y(y), x(x), r(r) {}
-};
-
-vector<Put> backCalcPutList(const Field &f, const BitField &bf, UsedMask u) {
-  vector<Put> ret;
-  for (int y = 0; y < 32; ++y) {
-    for (int x = 0; x < 32; ++x) {
-      if (bf[y << 5 | x] && u[f[y][x]]) {
-        u[f[y][x]] = 0;
-        vector<Point> stone;
-        for (int sy = 0; sy < 8; ++sy) {
-          for (int sx = -8; sx < 8; ++sx) {
-            if (isInsideField(x + sx, y + sy)) {
-              if (bf[(y + sy) << 5 | (x + sx)] &&
-                  f[y][x] == f[y + sy][x + sx]) {
-                stone.emplace_back(sx, sy);
-              }
-            }
-          }
-        }
-        sort(stone.begin(), stone.end());
-        bool found = false;
-        for (int r = 0; r < 8; ++r) {
-          if (g.stone_pattern_vector[f[y][x]][r] == stone) {
-            ret.emplace_back(f[y][x], x, y, r);
-            found = true;
-            break;
-          }
-        }
-        assert(found);
-      }
-    }
-  }
-  return std::move(ret);
+  vector<thread> threads;
+  for (int j = 1; j < jobs; ++j) threads.emplace_back(worker);
+  worker();
+  for (auto &t : threads) t.join();
+  return failed ? 1 : 0;
 }
 
-class GameState {
- private:
-  UsedMask used_;
-  BitField bit_field_;
-  Field field_;
-  uint32_t hash_value_;
-  int32_t score_;
-  int16_t empty_count_;
-  uint8_t trans_state_;
-
-  GameState() = delete;
-  GameState(const GameState &) = delete;
-  ~GameState() = delete;
-
-  static list<GameState *> pool_;
-
+// std::streambuf over a file descriptor, for the daemon's socket clients.
+class FdStreamBuf : public streambuf {
  public:
-  GameState *init() {
-    assert(g.fix_);
-    used_ = UsedMask();
-    bit_field_ = BitField();
-    field_ = Field();
-    empty_count_ = g.default_empty_count;
-    trans_state_ = 0;
-    hash_value_ = 0;
-    score_ = 100000;
-    return this;
-  }
-
-  static GameState *alloc() {
-    if (pool_.empty()) {
-      static const int N = 32768;
-      GameState *p =
-          static_cast<GameState *>(std::malloc(sizeof(GameState) * N));
-      for (int i = 0; i < N; ++i) pool_.push_back(&p[i]);
+  explicit FdStreamBuf(int fd) : fd_(fd) {
+    setg(in_, in_, in_);
+    setp(out_, out_ + sizeof(out_));
+  }
+  ~FdStreamBuf() { sync(); }
+
+ protected:
+  int underflow() override {
+    const ssize_t n = read(fd_, in_, sizeof(in_));
+    if (n <= 0) return traits_type::eof();
+    setg(in_, in_, in_ + n);
+    return traits_type::to_int_type(*gptr());
+  }
+  int overflow(int c) override {
+    if (sync() != 0) return traits_type::eof();
+    if (c != traits_type::eof()) {
+      *pptr() = static_cast<char>(c);
+      pbump(1);
     }
-    GameState *p = pool_.back();
-    pool_.pop_back();
-#ifdef DEBUG_MEMORY_CHECK
-    g.total_alloc_count++;
-#endif
-    return p;
-  }
-
-  static void free(GameState *p) {
-    pool_.push_back(p);
-#ifdef DEBUG_MEMORY_CHECK
-    g.total_free_count++;
-#endif
-  }
-
-  GameState *clone() const {
-    GameState *q = alloc();
-    q->used_ = used_;
-    q->bit_field_ = bit_field_;
-    q->field_ = field_;
-    q->empty_count_ = empty_count_;
-    q->trans_state_ = trans_state_;
-    q->hash_value_ = hash_value_;
-    q->score_ = score_;
-    return q;
+    return traits_type::not_eof(c);
   }
-
-  SolverAnswer toAnswer() const {
-    GameState *s = this->clone();
-    SolverAnswerBuilder builder(g.problem);
-    s->transDefault();
-    const auto log =
-        backCalcPutList(s->getField(), s->getBitField(), s->getUsedMask());
-    for (const auto &put : log) {
-      const int x = put.x - g.stone_pattern_origin[put.id][put.r].x;
-      const int y = put.y - g.stone_pattern_origin[put.id][put.r].y;
-      builder.put(put.id, x, y, put.r / 4, put.r % 4);
-    }
-    GameState::free(s);
-    return builder.build();
-  }
-
-  vector<Put> getAvailableList(int x, int y) const {
-    vector<Put> ret;
-    bitset<256 * 8> bits;
-    for (int u = 0; u < 8; ++u) {
-      for (int v = -7; v < 8; ++v) {
-        const int ny = y + u;
-        const int nx = x + v;
-        if (isInsideField(nx, ny) && isEmpty(nx, ny))
-          ;
-        else {
-          bits |= g.stone_pattern_mask[u][v + 8];
-        }
-      }
-    }
-
-    for (int i = 0; i < 256 * 8; ++i) {
-      if (used_[i / 8] || bits[i]) {
-        continue;
-      } else {
-        Put p = Put(i / 8, x, y, i % 8);
-        if (available(p)) {
-          ret.push_back(p);
-        }
-      }
-    }
-    return std::move(ret);
-  }
-
-  bool available(const Put &put, bool reverse = false) const {
-    if (g.stone_pattern_vector.size() <= put.id) return false;
-    if (isUsed(put.id)) return false;
-    if (g.stone_pattern_vector[put.id][put.r].empty()) return false;
-    bool ok = isFirstStone();
-    for (auto pos : g.stone_pattern_vector[put.id][put.r]) {
-      if (isInsideField(put.x + pos.x, put.y + pos.y) &&
-          isEmpty(put.x + pos.x, put.y + pos.y))
-        ;
-      else
-        return false;
-      if (!ok) {
-        for (int r = 0; r < 4; ++r) {
-          const int x = put.x + dx[r];
-          const int y = put.y + dy[r];
-          if (isInsideField(x, y) && isStone(x, y)) {
-            if (!reverse && field_[y][x] < put.id) {
-              ok = true;
-            }
-            if (reverse && field_[y][x] > put.id) {
-              ok = true;
-            }
-          }
-        }
-      }
-    }
-    return ok;
-  }
-
-  void put(const Put &put) {
-    const auto &stone = g.stone_pattern_vector[put.id][put.r];
-    const auto size = stone.size();
-    assert(size);
-    for (const auto &pos : stone) {
-      const auto p = Point(put.x + pos.x, put.y + pos.y);
-      assert(field_[p.y][p.x] == 0);
-      assert(!bit_field_[p.to1d()]);
-      field_[p.y][p.x] = put.id;
-      bit_field_[p.to1d()] = 1;
-      const auto q = Transform::trans(trans_state_, 0, p);
-      hash_value_ ^= FieldHash::get(q.x, q.y, size);
-    }
-    assert(!used_[put.id]);
-    used_[put.id] = 1;
-    empty_count_ -= size;
-  }
-
-  void undo(const Put &put) {
-    const auto &stone = g.stone_pattern_vector[put.id][put.r];
-    const auto size = stone.size();
-    assert(size);
-    for (const auto &pos : stone) {
-      const auto p = Point(put.x + pos.x, put.y + pos.y);
-      assert(field_[p.y][p.x] == put.id);
-      assert(bit_field_[p.to1d()]);
-      field_[p.y][p.x] = 0;
-      bit_field_[p.to1d()] = 0;
-      const auto q = Transform::trans(trans_state_, 0, p);
-      hash_value_ ^= FieldHash::get(q.x, q.y, size);
-    }
-    assert(used_[put.id]);
-    used_[put.id] = 0;
-    empty_count_ += size;
-  }
-
-  uint32_t preHash(const Put &put) const {
-    uint32_t hash = hash_value_;
-    const auto &stone = g.stone_pattern_vector[put.id][put.r];
-    const auto size = stone.size();
-    for (const auto &pos : stone) {
-      const auto q =
-          Transform::trans(trans_state_, 0, put.x + pos.x, put.y + pos.y);
-      hash ^= FieldHash::get(q.x, q.y, size);
+  int sync() override {
+    for (char *p = pbase(); p < pptr();) {
+      const ssize_t n = write(fd_, p, pptr() - p);
+      if (n <= 0) return -1;
+      p += n;
     }
-    return hash;
+    setp(out_, out_ + sizeof(out_));
+    return 0;
   }
 
-  int calcSimpleScore(const Put &put) const {
-    int score = 0;
-    const auto &stone = g.stone_pattern_vector[put.id][put.r];
-    score += stone.size() * stone.size();
-    if (isFirstStone()) {
-      score -= (int)put.id * put.id;
-    } else {
-      int min_around_id = 255;
-      for (const auto &pos : stone) {
-        for (int r = 0; r < 4; ++r) {
-          const int x = pos.x + put.x + dx[r];
-          const int y = pos.y + put.y + dy[r];
-          if (isInsideField(x, y)) {
-            if (isStone(x, y) && field_[y][x] < put.id) {
-              min_around_id = min(min_around_id, (int)field_[y][x]);
-            }
-          }
-        }
-      }
-      score -= g.weight_diff_id * (put.id - min_around_id);
-    }
-    return score;
-  }
+ private:
+  int fd_;
+  char in_[4096];
+  char out_[4096];
+};
 
-  void gvField() const {
-    int count = 0;
-    for (int y = 0; y < 32; y++) {
-      for (int x = 0; x < 32; x++) {
-        if (g.default_field[trans_state_][y][x]) {
-          if (bit_field_[y << 5 | x]) {
-            gvRect(x, y, 1, 1, gvRGB(128, 0, 0));
-          } else {
-            count++;
-            gvRect(x, y, 1, 1, gvRGB(0));
-          }
-        } else if (bit_field_[y << 5 | x]) {
-          count++;
-          gvRect(x, y, 1, 1, gvColor(field_[y][x]));
-          gvText(x + 0.5, y + 0.5, 0.2, gvRGB(0, 0, 0), "%d", field_[y][x]);
-        }
-      }
-    }
-    gvText(10, -1, "%d/1024", count);
-    gvRect(-20, 0, 19, 32, gvRGB(0xEEEEEE));
-    int Y = 0;
-    gvText(-10, Y++, "put_size = %d", used_.count());
-    gvText(-10, Y++, "trans_state = %d", trans_state_);
-    int cnt[17] = {0};
-    for (int i = 0; i < g.stone_pattern_vector.size(); ++i) {
-      if (!isUsed(i)) {
-        cnt[g.stone_pattern_vector[i][0].size()]++;
-      }
+// Solve every problem read from `is` in turn. Improvements are written as
+// "answer <empty> <stones>" as the search finds them, at most once per
+// `-ex answer_interval` ms (1000 by default) and always at the end of an
+// orientation, and the final one as "done <empty> <stones>", each followed
+// by the answer in the SolverAnswerWriter format. A problem
+// that fails gets a single "error <message>" line instead of "done"; after
+// a malformed problem the rest of the stream cannot be trusted, so serving
+// it ends there.
+void serveProblems(istream &is, ostream &os, const SolverParameter &parameter) {
+  while (is >> ws && is.peek() != EOF) {
+    Problem problem;
+    string error;
+    if (!ProblemReader::parse(is, problem, error)) {
+      os << "error malformed problem, " << error << "\r\n" << flush;
+      break;
     }
-    for (int i = 1; i <= 16; ++i) {
-      gvText(-10, Y++, "%2d %3d", i, cnt[i]);
+    SolverParameter p = parameter;
+    if (!p.extra_parameter.count("answer_files")) {
+      p.extra_parameter["answer_files"] = "0";
     }
-  }
-
-  void trans(int to) {
-    assert(to >= 0 && to < 8);
-    if (trans_state_ == to) return;
-    field_.transform(trans_state_, to);
-    bit_field_.transform(trans_state_, to);
-    trans_state_ = to;
-  }
-  void trans() { trans((trans_state_ + 1) % 8); }
-  void transDefault() { trans(0); }
-  void transRotate(int r) {
-    trans((trans_state_ >= 4) * 4 + (trans_state_ + r) % 4);
-  }
-  uint8_t getTransState() const { return trans_state_; }
-  const Field &getField() const { return field_; }
-  const BitField &getBitField() const { return bit_field_; }
-  const UsedMask &getUsedMask() const { return used_; }
-  bool isFirstStone() const { return !used_.any(); }
-  bool isUsed(int i) const { return used_[i]; }
-  int getEmptyCount() const { return empty_count_; }
-  void addScore(int score) { score_ += score; };
-  int getScore() const { return score_; }
-  uint32_t getHash() const { return hash_value_; }
-  bool isStone(int x, int y) const {
-    assert(isInsideField(x, y));
-    return bit_field_[y << 5 | x];
-  }
-  bool isBlock(int x, int y) const {
-    assert(isInsideField(x, y));
-    return g.default_field[trans_state_][y][x];
-  }
-  bool isEmpty(int x, int y) const {
-    assert(isInsideField(x, y));
-    return bit_field_[y << 5 | x] == 0 &&
-           g.default_field[trans_state_][y][x] == 0;
-  }
-};
-list<GameState *> GameState::pool_;
-
-class SampleSolver {
- public:
-  SampleSolver(const Problem &problem, SolverParameter &parameter)
-      : problem_(problem), parameter_(parameter) {}
-
-  SolverAnswer run() {
-    hash_map.set_empty_key(0);
-    gvInit();
-    g.init(problem_);
-    return solve();
-  }
-
- private:
-  vector<Point> getNextTargetPos(const GameState &state) {
-    uint16_t f[32][32] = {{0}};
-    int count = 0;
-    union CountIdPair {
-      uint32_t value;
-      struct {
-        uint16_t id;
-        uint16_t count;
-      };
-      CountIdPair(uint16_t id, uint16_t count) : id(id), count(count) {}
-      bool operator<(const CountIdPair &o) const { return value < o.value; }
+    const chrono::milliseconds interval(
+        p.extra_parameter.count("answer_interval")
+            ? stoi(p.extra_parameter["answer_interval"])
+            : 1000);
+    Solver solver(problem, p);
+    int empty = 1024, stones = 0;
+    auto last_sent = chrono::steady_clock::now() - interval;
+    auto send = [&](const SolverAnswer &answer, int e, int s) {
+      empty = e;
+      stones = s;
+      last_sent = chrono::steady_clock::now();
+      os << "answer " << e << " " << s << "\r\n";
+      SolverAnswerWriter(problem, answer).write(os);
+      os << flush;
     };
-    vector<CountIdPair> count_id;
-    queue<Point> Q;
-    for (int y = 0; y < 32; ++y) {
-      for (int x = 0; x < 32; ++x) {
-        if (f[y][x] == 0 && state.isEmpty(x, y)) {
-          count++;
-          f[y][x] = count;
-          count_id.emplace_back(count, 1);
-          Q.emplace(x, y);
-          while (!Q.empty()) {
-            auto p = Q.front();
-            Q.pop();
-            for (int r = 0; r < 4; ++r) {
-              const int nx = p.x + dx[r];
-              const int ny = p.y + dy[r];
-              if (isInsideField(nx, ny) && f[ny][nx] == 0 &&
-                  state.isEmpty(nx, ny)) {
-                f[ny][nx] = count;
-                count_id[count - 1].count++;
-                Q.emplace(nx, ny);
-              }
-            }
-          }
-        }
-      }
+    solver.onProgress([&](const SolverProgress &progress) {
+      if (chrono::steady_clock::now() - last_sent < interval) return;
+      send(progress.answer(), progress.empty, progress.stones);
+    });
+    // the orientation's best, unless onProgress has already sent it.
+    solver.onAnswer([&](const SolverAnswer &answer, int e, int s) {
+      if (e != empty || s != stones) send(answer, e, s);
+    });
+    SolverAnswer answer;
+    try {
+      answer = solver.run();
+    } catch (const SolverError &e) {
+      os << "error " << e.what() << "\r\n" << flush;
+      continue;
     }
-
-    if (count == 0) return {};
-    auto best_area = min_element(count_id.begin(), count_id.end())->id;
-
-    for (int y = 0; y < 32; ++y) {
-      for (int x = 0; x < 32; ++x) {
-        if (f[y][x] == best_area) {
-          for (int r = 0; r < 4; ++r) {
-            int nx = x + dx[r];
-            int ny = y + dy[r];
-            if (isInsideField(nx, ny)) {
-              if (state.isStone(nx, ny)) {
-                return {Point(x, y)};
-              }
-            }
-          }
-        }
-      }
-    }
-    assert(false);
+    os << "done " << empty << " " << stones << "\r\n";
+    SolverAnswerWriter(problem, answer).write(os);
+    if (!os) break;
   }
+}
 
-  void beamSearch(vector<GameState *> &init, GameState **best, int beam_width) {
-    vector<vector<GameState *>> state_av(1024);
-    for (GameState *p : init) {
-      assert(!p->isFirstStone());
-      state_av[p->getEmptyCount()].push_back(p);
+// -daemon: keep the tables and the pool warm and serve problems from stdin
+// ("-") or from clients of a Unix domain socket, one client at a time.
+int runDaemon(const SolverParameter &parameter) {
+  signal(SIGPIPE, SIG_IGN);
+  if (parameter.daemon_socket == "-") {
+    serveProblems(cin, cout, parameter);
+    return 0;
+  }
+  const int server = socket(AF_UNIX, SOCK_STREAM, 0);
+  sockaddr_un addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  strncpy(addr.sun_path, parameter.daemon_socket.c_str(),
+          sizeof(addr.sun_path) - 1);
+  // only a stale socket is removed, never a file named by mistake.
+  struct stat st;
+  if (lstat(addr.sun_path, &st) == 0) {
+    if (!S_ISSOCK(st.st_mode)) {
+      cerr << "cannnot listen on the socket, the path is not a socket. "
+           << parameter.daemon_socket << endl;
+      return 1;
     }
-    init.clear();
-
-    auto add_next = [this, &state_av, &best](GameState *p, Put put, int score) {
-      auto *s = p->clone();
-      s->addScore(score);
-      s->put(put);
-      auto e = s->getEmptyCount();
-      if ((*best)->getEmptyCount() > e ||
-          ((*best)->getEmptyCount() == e &&
-           (*best)->getUsedMask().count() > s->getUsedMask().count())) {
-        GameState::free(*best);
-        *best = s->clone();
-      }
-      if (e == 0) {
-        g.total_complete_count++;
-      }
-      state_av[e].emplace_back(s);
-      return true;
-    };
-
-    for (int k = 1023; k--;) {
-      auto &v = state_av[k];
-      if (v.empty()) continue;
-      cerr << k << " " << v.size() << endl;
-
-      const int n = min(beam_width, (int)v.size());
-      if (v.size() > beam_width) {
-        std::nth_element(v.begin(), v.begin() + beam_width, v.end(),
-                         [](const GameState *a, const GameState *b) {
-          return a->getScore() > b->getScore();
-        });
-        while (v.size() > beam_width) {
-          GameState::free(v.back());
-          v.pop_back();
-        }
-      }
-
-      for (int i = 0; i < n; ++i) {
-        auto &state = *v.back();
-        auto pos_list = getNextTargetPos(state);
-        for (auto &pos : pos_list) {
-          auto available_list = state.getAvailableList(pos.x, pos.y);
-          for (auto put : available_list) {
-            // if (g.stone_pattern_vector[put.id][put.r].size() == 1) continue;
-            const auto sc = state.calcSimpleScore(put);
-            const auto hash = state.preHash(put);
-            if (hash_map[hash] > state.getScore() + sc) continue;
-            hash_map[hash] = state.getScore() + sc;
-            add_next(&state, put, sc);
-          }
-        }
-        GameState::free(&state);
-        v.pop_back();
-      }
-      v.shrink_to_fit();
+    unlink(addr.sun_path);
+  }
+  if (server < 0 || ::bind(server, (sockaddr *)&addr, sizeof(addr)) != 0 ||
+      listen(server, 8) != 0) {
+    cerr << "cannnot listen on the socket. " << parameter.daemon_socket
+         << endl;
+    return 1;
+  }
+  for (;;) {
+    const int client = accept(server, nullptr, nullptr);
+    if (client < 0) continue;
+    {
+      FdStreamBuf buf(client);
+      iostream stream(&buf);
+      serveProblems(stream, stream, parameter);
     }
+    close(client);
   }
+}
 
-  void firstPut(int trans, vector<GameState *> &dst) {
-    GameState *a = GameState::alloc()->init();
-    a->trans(trans);
-    for (int y = 0; y < 32; ++y) {
-      for (int x = 0; x < 32; ++x) {
-        auto putList = a->getAvailableList(x, y);
-        if (!putList.empty()) {
-          for (auto put : putList) {
-            GameState *b = a->clone();
-            b->addScore(b->calcSimpleScore(put));
-            b->put(put);
-            dst.push_back(b);
-          }
-          GameState::free(a);
-          return;
-        }
-      }
+// SIGTERM/SIGINT flush. The latest best answer is kept serialised in one of
+// two slots, so the handler only needs open, write and _exit. The search
+// and update() run on the main thread, and the solver's helper threads
+// (answer writer, heartbeat) block both signals, so the handler can only
+// interrupt the main thread between two steps of update(). It never sees
+// the slot being filled, and the signal fences keep the copy into the slot
+// before `ready` is published.
+struct EmergencyAnswer {
+  struct Slot {
+    char file[4096];  // answer_prefix + "NNNN_MMM.ans", empty when disabled
+    char text[16384];
+    size_t size;
+  };
+  Slot slot[2];
+  volatile sig_atomic_t ready = -1;
+  char answer_file[4096] = {0};  // -o, stdout when empty
+  bool answer_files = true;
+  string answer_prefix;
+
+  void update(const Problem &problem, const SolverAnswer &answer, int empty,
+              int stones) {
+    Slot &s = slot[ready == 0];
+    ostringstream os;
+    SolverAnswerWriter(problem, answer).write(os);
+    const string text = os.str();
+    if (text.size() > sizeof(s.text)) return;
+    memcpy(s.text, text.data(), text.size());
+    s.size = text.size();
+    s.file[0] = 0;
+    if (answer_files) {
+      snprintf(s.file, sizeof(s.file), "%s%04d_%03d.ans",
+               answer_prefix.c_str(), empty, stones);
     }
-    GameState::free(a);
+    atomic_signal_fence(memory_order_release);
+    ready = &s - slot;
   }
+};
+static EmergencyAnswer emergency;
+
+static void flushAnswer(const char *file, const EmergencyAnswer::Slot &s) {
+  const int fd =
+      file[0] ? open(file, O_WRONLY | O_CREAT | O_TRUNC, 0644) : STDOUT_FILENO;
+  if (fd < 0) return;
+  for (size_t done = 0; done < s.size;) {
+    const ssize_t n = write(fd, s.text + done, s.size - done);
+    if (n <= 0) break;
+    done += n;
+  }
+  if (fd != STDOUT_FILENO) close(fd);
+}
 
-  SolverAnswer solve() {
-    if (parameter_.extra_parameter.find("w") !=
-        parameter_.extra_parameter.end()) {
-      cerr << "setting weight" << parameter_.extra_parameter["w"] << endl;
-      g.weight_diff_id = std::stoi(parameter_.extra_parameter["w"]);
-      cerr << g.weight_diff_id << endl;
-    }
-    GameState *best_state = GameState::alloc()->init();
-    size_t last_output_hash = best_state->getHash();
-    auto best_t = 0;
-
-    auto run_and_update = [this, &best_state, &last_output_hash, &best_t](
-        int trans, int beam_width) {
-      vector<GameState *> init;
-      firstPut(trans, init);
-      beamSearch(init, &best_state, beam_width);
-      hash_map.clear_no_resize();
-      if (last_output_hash != best_state->getHash()) {
-        last_output_hash = best_state->getHash();
-        best_t = trans;
-        auto ans = best_state->toAnswer();
-        auto ec = best_state->getEmptyCount();
-        auto uc = (int)best_state->getUsedMask().count();
-        char file_name[64];
-        sprintf(file_name, "%04d_%03d.ans", ec, uc);
-        SolverAnswerWriter(problem_, ans).write(file_name);
-      }
-    };
-
-    for (int t = 0; t < 8; ++t) {
-      run_and_update(t, 100);
-    }
-
-    /*
-            for (int w = 1000; w <= 4000; w += 1000) {
-                    run_and_update(best_t, w);
-            }
-     */
-
-    best_state->gvField();
-    gvNewTime();
-
-    auto vis = GameState::alloc()->init();
-    best_state->transDefault();
-    for (auto put :
-         backCalcPutList(best_state->getField(), best_state->getBitField(),
-                         best_state->getUsedMask())) {
-      vis->put(put);
-      vis->gvField();
-      gvNewTime();
+extern "C" void onTerminate(int sig) {
+  const int i = emergency.ready;
+  atomic_signal_fence(memory_order_acquire);
+  if (i >= 0) {
+    flushAnswer(emergency.answer_file, emergency.slot[i]);
+    if (emergency.slot[i].file[0]) {
+      flushAnswer(emergency.slot[i].file, emergency.slot[i]);
     }
-
-    auto ans = best_state->toAnswer();
-    GameState::free(best_state);
-    GameState::free(vis);
-
-#ifdef DEBUG_MEMORY_CHECK
-    assert(g.total_alloc_count == g.total_free_count);
-#endif
-    return ans;
   }
-
-  const Problem &problem_;
-  SolverParameter &parameter_;
-  google::dense_hash_map<uint32_t, int> hash_map;
-};
+  _exit(128 + sig);
+}
 
 int main(int argc, char *argv[]) {
   auto parameter = SolverParameterParser().parse(argc, argv);
+  if (!parameter.batch_file.empty()) return runBatch(parameter);
+  if (!parameter.daemon_socket.empty()) return runDaemon(parameter);
   auto problem = ProblemReader().read(parameter.problem_file);
-  auto solver = SampleSolver(problem, parameter);
-  auto answer = solver.run();
+  Solver::setVisualization(true);
+  Solver solver(problem, parameter);
+
+  auto it = parameter.extra_parameter.find("answer_files");
+  if (it != parameter.extra_parameter.end()) {
+    emergency.answer_files = it->second != "0";
+  }
+  it = parameter.extra_parameter.find("answer_prefix");
+  if (it != parameter.extra_parameter.end()) {
+    emergency.answer_prefix = it->second;
+  }
+  strncpy(emergency.answer_file, parameter.answer_file.c_str(),
+          sizeof(emergency.answer_file) - 1);
+  solver.onProgress([&](const SolverProgress &progress) {
+    emergency.update(problem, progress.answer(), progress.empty,
+                     progress.stones);
+  });
+  struct sigaction action;
+  memset(&action, 0, sizeof(action));
+  action.sa_handler = onTerminate;
+  sigemptyset(&action.sa_mask);
+  sigaction(SIGTERM, &action, nullptr);
+  sigaction(SIGINT, &action, nullptr);
+
+  SolverAnswer answer;
+  try {
+    answer = solver.run();
+  } catch (const SolverError &e) {
+    cerr << e.what() << endl;
+    return 1;
+  }
   if (parameter.answer_file.empty()) {
     SolverAnswerWriter(problem, answer).write(cout);
   } else {
     SolverAnswerWriter(problem, answer).write(parameter.answer_file);
   }
-#ifdef DEBUG_MEMORY_CHECK
-  cerr << "[last] alloc " << g.total_alloc_count << " free "
-       << g.total_free_count << endl;
-#endif
   return 0;
 }
@@ -0,0 +1,80 @@
+﻿/*
+The MIT License (MIT)
+
+Copyright (c) 2015 Shingo INADA
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+
+// Checks answer files against a problem with the contest rules, e.g.
+//   verify -i problem.txt 0000_088.ans 0012_070.ans
+// one line per answer, exit status 1 if any answer is invalid.
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "common.hpp"
+#include "procon26.hpp"
+
+using namespace std;
+
+int main(int argc, char *argv[]) {
+  string problem_file;
+  vector<string> answer_files;
+  for (int i = 1; i < argc; ++i) {
+    const string arg = argv[i];
+    if (arg == "-i" && i + 1 < argc) {
+      problem_file = argv[++i];
+    } else {
+      answer_files.push_back(arg);
+    }
+  }
+  if (problem_file.empty() || answer_files.empty()) {
+    cerr << "Usage: verify -i problem_path answer_path..." << endl;
+    return 1;
+  }
+
+  const auto problem = ProblemReader().read(problem_file);
+  int invalid = 0;
+  for (const auto &file : answer_files) {
+    ifstream ifs(file);
+    if (!ifs) {
+      cerr << "cannnot open the answer_file. " << file << endl;
+      invalid++;
+      continue;
+    }
+    SolverAnswer answer;
+    AnswerCheck check;
+    if (!SolverAnswerReader::parse(ifs, problem, answer, check.error)) {
+      check.valid = false;
+    } else {
+      check = verifyAnswer(problem, answer);
+    }
+    if (check.valid) {
+      cout << file << " ok empty " << check.empty << " stones "
+           << check.stones << "\n";
+    } else {
+      cout << file << " invalid " << check.error << "\n";
+      invalid++;
+    }
+  }
+  return invalid ? 1 : 0;
+}
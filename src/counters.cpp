@@ -0,0 +1,81 @@
+﻿/*
+The MIT License (MIT)
+
+Copyright (c) 2015 Shingo INADA
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#include "counters.hpp"
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <vector>
+
+namespace {
+
+const char *const kCounterName[kCounterCount] = {
+    "available", "mask_rejected", "alloc", "clone", "free", "hash_probe"};
+
+std::mutex shard_mutex;
+std::vector<std::unique_ptr<CounterShard>> shards;
+
+// destroyed before `shards`, which is defined above it.
+struct DumpAtExit {
+  ~DumpAtExit() {
+    std::lock_guard<std::mutex> lock(shard_mutex);
+    if (!shards.empty()) dumpCounters(std::cerr);
+  }
+} dump_at_exit;
+
+}  // namespace
+
+void *CounterShard::operator new(size_t size) {
+  void *p = nullptr;
+  if (posix_memalign(&p, alignof(CounterShard), size) != 0) {
+    throw std::bad_alloc();
+  }
+  return p;
+}
+
+void CounterShard::operator delete(void *p) { free(p); }
+
+CounterShard *registerCounterShard() {
+  std::unique_ptr<CounterShard> shard(new CounterShard);
+  for (auto &v : shard->value) v.store(0, std::memory_order_relaxed);
+  std::lock_guard<std::mutex> lock(shard_mutex);
+  shards.push_back(std::move(shard));
+  return shards.back().get();
+}
+
+void dumpCounters(std::ostream &os) {
+  uint64_t sum[kCounterCount] = {0};
+  for (const auto &shard : shards) {
+    for (int i = 0; i < kCounterCount; ++i) {
+      sum[i] += shard->value[i].load(std::memory_order_relaxed);
+    }
+  }
+  os << "[counters]";
+  for (int i = 0; i < kCounterCount; ++i) {
+    os << " " << kCounterName[i] << " " << sum[i];
+  }
+  os << std::endl;
+}
@@ -0,0 +1,78 @@
+﻿/*
+The MIT License (MIT)
+
+Copyright (c) 2015 Shingo INADA
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+
+// Hot path event counters. Unless PROCON26_COUNTERS is defined (cmake
+// -DPROCON26_COUNTERS=ON) PROCON26_COUNT expands to nothing. When enabled
+// every thread bumps its own shard with relaxed atomics, so counting takes
+// no lock and shares no cache line; the shards are summed when the process
+// exits.
+enum Counter {
+  kAvailable,     // GameState::available calls
+  kMaskRejected,  // getAvailableList candidates cut by the pattern mask
+  kAlloc,         // GameState::alloc
+  kClone,         // GameState::clone
+  kFree,          // GameState::free
+  kHashProbe,     // duplicate table lookups
+  kCounterCount
+};
+
+// one cache line per shard, so threads bumping their own never contend.
+struct alignas(64) CounterShard {
+  std::atomic<uint64_t> value[kCounterCount];
+
+  // plain new only promises alignof(max_align_t) before C++17.
+  static void *operator new(size_t size);
+  static void operator delete(void *p);
+};
+
+// a new zeroed shard, kept until exit.
+CounterShard *registerCounterShard();
+
+// the sums over all shards, one "name value" pair per counter.
+void dumpCounters(std::ostream &os);
+
+#ifdef PROCON26_COUNTERS
+inline CounterShard &counterShard() {
+  static thread_local CounterShard *shard = registerCounterShard();
+  return *shard;
+}
+#define PROCON26_COUNT_N(counter, n)                                 \
+  do {                                                               \
+    auto &v_ = counterShard().value[counter];                        \
+    v_.store(v_.load(std::memory_order_relaxed) + (n),               \
+             std::memory_order_relaxed);                             \
+  } while (0)
+#else
+#define PROCON26_COUNT_N(counter, n) \
+  do {                               \
+  } while (0)
+#endif
+#define PROCON26_COUNT(counter) PROCON26_COUNT_N(counter, 1)
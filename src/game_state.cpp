@@ -0,0 +1,105 @@
+﻿/*
+The MIT License (MIT)
+
+Copyright (c) 2015 Shingo INADA
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#include "game_state.hpp"
+
+array<array<array<array<uint16_t, 32>, 32>, 8>, 8> Transform::trans_table_;
+bool Transform::built = false;
+
+bool FieldHash::built = false;
+array<uint32_t, 32 * 32 * 16> FieldHash::hash_table_;
+
+thread_local SolverContext *g = nullptr;
+
+MemoryBudget memory_budget;
+
+size_t MemoryBudget::stateBytes() const {
+  lock_guard<mutex> lock(state_counter_mutex_);
+  size_t sum = 0;
+  for (auto *c : state_counters_) sum += c->load(memory_order_relaxed);
+  return sum;
+}
+
+void MemoryBudget::attachStateCounter(const atomic<size_t> *counter) {
+  lock_guard<mutex> lock(state_counter_mutex_);
+  state_counters_.push_back(counter);
+}
+
+void MemoryBudget::detachStateCounter(const atomic<size_t> *counter) {
+  lock_guard<mutex> lock(state_counter_mutex_);
+  state_counters_.erase(
+      remove(state_counters_.begin(), state_counters_.end(), counter),
+      state_counters_.end());
+}
+
+thread_local GameState::Pool GameState::pool_;
+thread_local bool GameState::huge_page_ = false;
+thread_local size_t GameState::slab_limit_ = 0;
+
+GameState::Pool::Pool() { memory_budget.attachStateCounter(&state_bytes); }
+
+GameState::Pool::~Pool() {
+  memory_budget.detachStateCounter(&state_bytes);
+  for (const auto &slab : slabs) {
+    if (slab.mapped) {
+      munmap(slab.p, slab.bytes);
+    } else {
+      std::free(slab.p);
+    }
+    memory_budget.slab_bytes -= slab.accounted;
+  }
+}
+
+vector<Put> backCalcPutList(const Field &f, const BitField &bf, UsedMask u) {
+  vector<Put> ret;
+  for (int y = 0; y < 32; ++y) {
+    for (int x = 0; x < 32; ++x) {
+      if (bf[y << 5 | x] && u[f[y][x]]) {
+        u[f[y][x]] = 0;
+        vector<Point> stone;
+        for (int sy = 0; sy < 8; ++sy) {
+          for (int sx = -8; sx < 8; ++sx) {
+            if (isInsideField(x + sx, y + sy)) {
+              if (bf[(y + sy) << 5 | (x + sx)] &&
+                  f[y][x] == f[y + sy][x + sx]) {
+                stone.emplace_back(sx, sy);
+              }
+            }
+          }
+        }
+        sort(stone.begin(), stone.end());
+        bool found = false;
+        for (int r = 0; r < 8; ++r) {
+          if (g->stone_pattern_vector[f[y][x]][r] == stone) {
+            ret.emplace_back(f[y][x], x, y, r);
+            found = true;
+            break;
+          }
+        }
+        assert(found);
+      }
+    }
+  }
+  return std::move(ret);
+}
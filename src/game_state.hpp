@@ -0,0 +1,851 @@
+﻿/*
+The MIT License (MIT)
+
+Copyright (c) 2015 Shingo INADA
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bitset>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <list>
+#include <map>
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+#include <cassert>
+#include <cstring>
+#include <mutex>
+#include <sys/mman.h>
+#include "common.hpp"
+#include "counters.hpp"
+#include "trace.hpp"
+
+#define DEBUG_MEMORY_CHECK
+
+using namespace std;
+
+static const int dx[] = {1, 0, -1, 0};
+static const int dy[] = {0, 1, 0, -1};
+
+union Point {
+  uint16_t value;
+  struct {
+    char x;
+    char y;
+  };
+  Point() = default;
+  Point(char x, char y) : x(x), y(y) {}
+  Point operator+(const Point &o) const { return Point(x + o.x, y + o.y); }
+  Point operator-(const Point &o) const { return Point(x - o.x, y - o.y); }
+  bool operator==(const Point &o) const { return value == o.value; }
+  void operator+=(const Point &o) {
+    x += o.x;
+    y += o.y;
+  }
+  void operator-=(const Point &o) {
+    x -= o.x;
+    y -= o.y;
+  }
+  bool operator<(const Point &o) const { return y != o.y ? y < o.y : x < o.x; }
+  uint16_t to1d() const {
+    assert(y >= 0);
+    assert(x >= 0);
+    return y << 5 | x;
+  }
+  static Point from1d(uint16_t p) {
+    assert(!(p >> 10));
+    return Point(p & 0x1f, p >> 5);
+  }
+};
+
+struct Transform {
+  static array<array<array<array<uint16_t, 32>, 32>, 8>, 8> trans_table_;
+  static bool built;
+
+ public:
+  static Point trans(int from, int to, Point a) {
+    assert(built);
+    assert(from >= 0 && from < 8);
+    assert(to >= 0 && to < 8);
+    return Point::from1d(trans_table_[from][to][a.y][a.x]);
+  }
+  static Point trans(int from, int to, int x, int y) {
+    assert(built);
+    assert(from >= 0 && from < 8);
+    assert(to >= 0 && to < 8);
+    return Point::from1d(trans_table_[from][to][y][x]);
+  }
+
+  static void build() {
+    if (built) return;
+    built = true;
+
+    array<array<uint16_t, 32>, 32> origin;
+    for (int y = 0; y < 32; ++y) {
+      for (int x = 0; x < 32; ++x) {
+        origin[y][x] = y << 5 | x;
+      }
+    }
+
+    auto flip = [](array<array<uint16_t, 32>, 32> f, bool x = true) {
+      if (x) {
+        for (int i = 0; i < 32; ++i) {
+          std::reverse(f[i].begin(), f[i].end());
+        }
+      } else {
+        for (int i = 0; i < 16; ++i) {
+          std::swap(f[i], f[31 - i]);
+        }
+      }
+      return std::move(f);
+    };
+
+    auto rotate90 = [flip](array<array<uint16_t, 32>, 32> f, bool plus = true) {
+      for (int i = 0; i < 32; ++i) {
+        for (int j = i; j < 32; ++j) {
+          std::swap(f[i][j], f[j][i]);
+        }
+      }
+      return std::move(flip(std::move(f), plus));
+    };
+
+    auto save = [](array<array<uint16_t, 32>, 32> f, int from, int to) {
+      Transform::trans_table_[from][to] = f;
+    };
+
+    for (int i = 0; i < 8; ++i) {
+      auto g = origin;
+      save(g, i, i);
+      for (int k = 1; k < 8; ++k) {
+        int j = (i + k) % 8;
+        g = rotate90(g);
+        if (j % 4 == 0) g = flip(g);
+        save(g, j, i);
+      }
+    }
+  }
+};
+
+struct FieldHash {
+  static bool built;
+  static void build() {
+    built = true;
+    std::mt19937 mt;
+    // mt.seed(std::random_device()());
+    for (int i = 0; i < hash_table_.size(); ++i) {
+      hash_table_[i] = mt();
+    }
+  }
+  static uint32_t get(int x, int y, int s) {
+    assert(built);
+    assert(x >= 0 && x < 32);
+    assert(y >= 0 && y < 32);
+    assert(s >= 1 && s <= 16);
+    return hash_table_[y << 9 | x << 4 /*| (s - 1) */];
+  }
+
+ private:
+  static array<uint32_t, 32 * 32 * 16> hash_table_;
+};
+
+struct Field : public array<array<uint8_t, 32>, 32> {
+  Field() {
+    for (int i = 0; i < 32; ++i) (*this)[i].fill(0);
+  };
+
+  void transform(int from, int to) {
+    Field f;
+    for (int y = 0; y < 32; ++y) {
+      for (int x = 0; x < 32; ++x) {
+        auto p = Transform::trans(from, to, x, y);
+        f[p.y][p.x] = (*this)[y][x];
+      }
+    }
+    *this = std::move(f);
+  }
+};
+
+struct BitField : public bitset<32 * 32> {
+  size_t hash() const {
+    static std::hash<bitset<32 * 32>> h;
+    return h(*this);
+  }
+  void transform(int from, int to) {
+    BitField f;
+    for (int y = 0; y < 32; ++y) {
+      for (int x = 0; x < 32; ++x) {
+        auto p = Transform::trans(from, to, x, y);
+        f[p.to1d()] = (*this)[y << 5 | x];
+      }
+    }
+    *this = std::move(f);
+  }
+};
+
+struct UsedMask : public bitset<256> {};
+
+// Per-problem solver state. `g` points at the context of the problem being
+// solved on the current thread, so several problems can run side by side.
+struct SolverContext {
+  vector<array<vector<Point>, 8>> stone_pattern_vector;
+  vector<array<Point, 8>> stone_pattern_origin;
+  vector<array<uint8_t, 8>> stone_pattern_alias;
+  array<array<bitset<256 * 8>, 16>, 8> stone_pattern_mask;
+  array<Field, 8> default_field;
+  int default_empty_count = 1024;
+  int total_complete_count = 0;
+  Problem problem;
+  size_t total_alloc_count = 0;
+  size_t total_free_count = 0;
+  int weight_diff_id = 5;
+
+  bool fix_ = false;
+  void init(Problem problem_) {
+    if (fix_) return;
+    fix_ = true;
+    problem = problem_;
+    static once_flag tables;
+    call_once(tables, [] {
+      Transform::build();
+      FieldHash::build();
+    });
+
+    for (int y = 0; y < 32; y++) {
+      for (int x = 0; x < 32; x++) {
+        default_field[0][y][x] = problem_.field[y][x];
+        if (problem_.field[y][x]) default_empty_count--;
+      }
+    }
+
+    for (int i = 1; i < 8; ++i) {
+      default_field[i] = default_field[0];
+      default_field[i].transform(0, i);
+    }
+
+    vector<array<array<bitset<8>, 8>, 8>> stone_pattern_list_;
+    stone_pattern_list_.resize(problem_.stone_list.size());
+    for (int i = 0; i < problem_.stone_list.size(); ++i) {
+      const auto &stone = problem_.stone_list[i];
+      for (int y = 0; y < 8; y++) {
+        for (int x = 0; x < 8; x++) {
+          if (stone[y][x]) {
+            stone_pattern_list_[i][0][y][x] = 1;
+            stone_pattern_list_[i][4][y][7 - x] = 1;
+          }
+        }
+      }
+    }
+
+    for (int i = 0; i < problem_.stone_list.size(); ++i) {
+      for (int j = 1; j < 8; j++) {
+        if (j % 4 == 0) continue;
+        for (int y = 0; y < 8; y++) {
+          for (int x = 0; x < 8; x++) {
+            stone_pattern_list_[i][j][x][7 - y] =
+                stone_pattern_list_[i][j - 1][y][x];
+          }
+        }
+      }
+    }
+
+    stone_pattern_vector.resize(problem_.stone_list.size());
+    stone_pattern_origin.resize(problem_.stone_list.size());
+    stone_pattern_alias.resize(problem_.stone_list.size());
+    for (int i = 0; i < problem_.stone_list.size(); ++i) {
+      map<set<Point>, int> stone_vector_set;
+      for (int j = 0; j < 8; j++) {
+        set<Point> sample_vector;
+        sample_vector.emplace(0, 0);
+        bool found = false;
+        Point p(0, 0);
+        for (int y = 0; y < 8; y++) {
+          for (int x = 0; x < 8; x++) {
+            if (stone_pattern_list_[i][j][y][x]) {
+              Point q(x, y);
+              if (!found) {
+                p = q;
+                found = true;
+              } else {
+                sample_vector.emplace(q - p);
+              }
+            }
+          }
+        }
+
+        auto result = stone_vector_set.emplace(sample_vector, j);
+        stone_pattern_origin[i][j] = p;
+        stone_pattern_alias[i][j] = result.first->second;
+        if (result.second) {
+          for (const auto &p : sample_vector) {
+            assert(p.x > -8 && p.x < 8);
+            assert(p.y >= 0 && p.y < 8);
+            stone_pattern_vector[i][j].emplace_back(p.x, p.y);
+            stone_pattern_mask[p.y][p.x + 8][8 * i + j] = true;
+          }
+        } else {
+          for (int y = 0; y < 8; ++y) {
+            for (int x = 0; x < 16; ++x) {
+              stone_pattern_mask[y][x][8 * i + j] = true;
+            }
+          }
+        }
+      }
+    }
+  }
+};
+extern thread_local SolverContext *g;
+
+template <class T>
+bool isInsideField(T x, T y) {
+  return !(x >> 5 | y >> 5);
+}
+
+template <class T>
+bool isInsideField(const T &p) {
+  return isInsideField(p.x, p.y);
+}
+
+// Byte accounting for the large solver structures. The counters are shared
+// by every solver in the process; the limit is a solver's own (-ex
+// mem_limit, in MB), and its beam search checks the counters against it at
+// every bucket boundary.
+struct MemoryBudget {
+  atomic<size_t> slab_bytes{0};  // state slabs and their free lists
+  atomic<size_t> bucket_bytes{0};
+  atomic<size_t> table_bytes{0};
+  atomic<size_t> peak{0};
+
+  // live states are counted per thread (see GameState::Pool) so that alloc
+  // and free touch no shared line; reading sums them under a lock.
+  size_t stateBytes() const;
+  void attachStateCounter(const atomic<size_t> *counter);
+  void detachStateCounter(const atomic<size_t> *counter);
+
+  size_t inUse() const { return stateBytes() + bucket_bytes + table_bytes; }
+  // what the process holds: slabs stay committed until their thread exits,
+  // however few states are live in them.
+  size_t committed() const { return slab_bytes + bucket_bytes + table_bytes; }
+  void update() {
+    const size_t v = committed();
+    size_t p = peak;
+    while (v > p && !peak.compare_exchange_weak(p, v)) {
+    }
+  }
+  bool pressed(size_t limit) const {
+    return limit && committed() > limit / 10 * 9;
+  }
+
+  // states per new slab: a sixteenth of the limit, so that committed memory
+  // can follow the beam closely under a small limit.
+  template <size_t StateBytes>
+  static int slabStates(size_t limit) {
+    static const int kMax = 32768, kMin = 256;
+    if (!limit) return kMax;
+    return (int)max<size_t>(kMin, min<size_t>(kMax, limit / 16 / StateBytes));
+  }
+
+  // replace this solver's share `reported` of `counter` with `bytes`.
+  static void account(atomic<size_t> &counter, size_t &reported,
+                      size_t bytes) {
+    counter += bytes - reported;
+    reported = bytes;
+  }
+
+  // VmHWM of this process in bytes, 0 if unknown.
+  static size_t peakRss() {
+    ifstream ifs("/proc/self/status");
+    string key;
+    while (ifs >> key) {
+      if (key == "VmHWM:") {
+        size_t kb;
+        ifs >> kb;
+        return kb * 1024;
+      }
+      ifs.ignore(numeric_limits<streamsize>::max(), '\n');
+    }
+    return 0;
+  }
+
+  void report(ostream &os, size_t limit) const {
+    const size_t mb = 1024 * 1024;
+    os << "[memory] peak " << peak / mb << " MB slab " << slab_bytes / mb
+       << " MB rss " << peakRss() / mb << " MB";
+    if (limit) os << " limit " << limit / mb << " MB";
+    os << endl;
+  }
+
+ private:
+  mutable mutex state_counter_mutex_;
+  vector<const atomic<size_t> *> state_counters_;
+};
+extern MemoryBudget memory_budget;
+
+union Put {
+  uint32_t value;
+  struct {
+    u_char id;
+    char y;
+    char x;
+    char r;
+  };
+  Put(u_char id, char x, char y, char r) : id(id), y(y), x(x), r(r) {}
+};
+
+vector<Put> backCalcPutList(const Field &f, const BitField &bf, UsedMask u);
+
+struct StateRecord {
+  int32_t score;
+  uint32_t hash;
+  uint8_t trans;
+  uint8_t reserved;
+  uint16_t put_count;
+
+  size_t size() const { return sizeof(*this) + put_count * sizeof(uint32_t); }
+};
+
+class GameState {
+ private:
+  UsedMask used_;
+  BitField bit_field_;
+  Field field_;
+  uint32_t hash_value_;
+  int32_t score_;
+  int16_t empty_count_;
+  uint8_t trans_state_;
+
+  GameState() = delete;
+  GameState(const GameState &) = delete;
+  ~GameState() = delete;
+
+  struct Slab {
+    void *p;
+    size_t bytes;  // mapped length, or the malloc size
+    bool mapped;
+    size_t accounted;  // its share of memory_budget.slab_bytes
+  };
+
+  // the free states and the slabs of one thread. States never move between
+  // threads, so the slabs go back to the system when their thread exits.
+  struct Pool {
+    vector<GameState *> free_list;
+    vector<Slab> slabs;
+    // bytes of live states, written by this thread only.
+    alignas(64) atomic<size_t> state_bytes{0};
+    Pool();
+    ~Pool();
+  };
+  static thread_local Pool pool_;
+
+  // With huge_page_ the slab is first tried on explicit huge pages, then as
+  // transparent huge pages, then falls back to malloc. The transparent
+  // huge page mapping is cut to a 2 MB boundary, as khugepaged only backs
+  // aligned 2 MB ranges.
+  static Slab allocSlab(size_t bytes) {
+    if (huge_page_) {
+      static const size_t H = 2 * 1024 * 1024;
+      const size_t len = (bytes + H - 1) / H * H;
+      void *p = mmap(nullptr, len, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+      if (p != MAP_FAILED) return {p, len, true, 0};
+      p = mmap(nullptr, len + H, PROT_READ | PROT_WRITE,
+               MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+      if (p != MAP_FAILED) {
+        char *base = static_cast<char *>(p);
+        char *aligned = reinterpret_cast<char *>(
+            (reinterpret_cast<uintptr_t>(base) + H - 1) / H * H);
+        if (aligned > base) munmap(base, aligned - base);
+        if (aligned + len < base + len + H) {
+          munmap(aligned + len, base + len + H - (aligned + len));
+        }
+        madvise(aligned, len, MADV_HUGEPAGE);
+        return {aligned, len, true, 0};
+      }
+      cerr << "[memory] huge page slab unavailable, using malloc" << endl;
+      huge_page_ = false;
+    }
+    return {std::malloc(bytes), bytes, false, 0};
+  }
+
+ public:
+  // set by the solver running on this thread at the start of each run.
+  static thread_local bool huge_page_;
+  static thread_local size_t slab_limit_;  // its mem_limit, sizes new slabs
+
+  GameState *init() {
+    assert(g->fix_);
+    used_ = UsedMask();
+    bit_field_ = BitField();
+    field_ = Field();
+    empty_count_ = g->default_empty_count;
+    trans_state_ = 0;
+    hash_value_ = 0;
+    score_ = 100000;
+    return this;
+  }
+
+  static GameState *alloc() {
+    auto &free_list = pool_.free_list;
+    if (free_list.empty()) {
+      const int n = MemoryBudget::slabStates<sizeof(GameState)>(slab_limit_);
+      const size_t capacity = free_list.capacity();
+      pool_.slabs.push_back(allocSlab(sizeof(GameState) * n));
+      auto &slab = pool_.slabs.back();
+      GameState *p = static_cast<GameState *>(slab.p);
+      for (int i = 0; i < n; ++i) free_list.push_back(&p[i]);
+      // a mapped slab commits its whole 2 MB rounded length.
+      slab.accounted = slab.bytes +
+                       (free_list.capacity() - capacity) * sizeof(GameState *);
+      memory_budget.slab_bytes += slab.accounted;
+      memory_budget.update();
+    }
+    GameState *p = free_list.back();
+    free_list.pop_back();
+    PROCON26_COUNT(kAlloc);
+    pool_.state_bytes.store(
+        pool_.state_bytes.load(memory_order_relaxed) + sizeof(GameState),
+        memory_order_relaxed);
+#ifdef DEBUG_MEMORY_CHECK
+    g->total_alloc_count++;
+#endif
+    return p;
+  }
+
+  static void free(GameState *p) {
+    pool_.free_list.push_back(p);
+    PROCON26_COUNT(kFree);
+    pool_.state_bytes.store(
+        pool_.state_bytes.load(memory_order_relaxed) - sizeof(GameState),
+        memory_order_relaxed);
+#ifdef DEBUG_MEMORY_CHECK
+    g->total_free_count++;
+#endif
+  }
+
+  GameState *clone() const {
+    PROCON26_COUNT(kClone);
+    GameState *q = alloc();
+    q->used_ = used_;
+    q->bit_field_ = bit_field_;
+    q->field_ = field_;
+    q->empty_count_ = empty_count_;
+    q->trans_state_ = trans_state_;
+    q->hash_value_ = hash_value_;
+    q->score_ = score_;
+    return q;
+  }
+
+  // bring the used mask and the bit board into cache ahead of expansion.
+  // field_ is only read around the target cell, so it is left alone.
+  void prefetch() const {
+    const char *p = reinterpret_cast<const char *>(&used_);
+    const char *end = reinterpret_cast<const char *>(&bit_field_ + 1);
+    for (; p < end; p += 64) {
+      __builtin_prefetch(p);
+    }
+  }
+
+  // compact record: StateRecord followed by put_count Put values.
+  void encode(vector<uint8_t> &buf) const {
+    const auto log = backCalcPutList(field_, bit_field_, used_);
+    StateRecord r;
+    r.score = score_;
+    r.hash = hash_value_;
+    r.trans = trans_state_;
+    r.reserved = 0;
+    r.put_count = static_cast<uint16_t>(log.size());
+    const size_t n = buf.size();
+    buf.resize(n + sizeof(r) + log.size() * sizeof(uint32_t));
+    memcpy(&buf[n], &r, sizeof(r));
+    for (size_t i = 0; i < log.size(); ++i) {
+      memcpy(&buf[n + sizeof(r) + i * sizeof(uint32_t)], &log[i].value,
+             sizeof(uint32_t));
+    }
+  }
+
+  static GameState *decode(const uint8_t *&p) {
+    StateRecord r;
+    memcpy(&r, p, sizeof(r));
+    p += sizeof(r);
+    GameState *s = alloc()->init();
+    s->trans(r.trans);
+    for (int i = 0; i < r.put_count; ++i) {
+      Put put(0, 0, 0, 0);
+      memcpy(&put.value, p, sizeof(uint32_t));
+      p += sizeof(uint32_t);
+      s->put(put);
+    }
+    s->score_ = r.score;
+    assert(s->hash_value_ == r.hash);
+    return s;
+  }
+
+  // decode() for a record read back from a file: nullptr unless every put
+  // is an unused stone of the problem that fits on the board and the hash
+  // matches.
+  static GameState *decodeChecked(const uint8_t *p, size_t bytes) {
+    StateRecord r;
+    if (bytes < sizeof(r)) return nullptr;
+    memcpy(&r, p, sizeof(r));
+    if (r.trans >= 8 || r.size() != bytes) return nullptr;
+    p += sizeof(r);
+    GameState *s = alloc()->init();
+    s->trans(r.trans);
+    for (int i = 0; i < r.put_count; ++i) {
+      Put put(0, 0, 0, 0);
+      memcpy(&put.value, p, sizeof(uint32_t));
+      p += sizeof(uint32_t);
+      if (!s->fits(put)) {
+        free(s);
+        return nullptr;
+      }
+      s->put(put);
+    }
+    s->score_ = r.score;
+    if (s->hash_value_ != r.hash) {
+      free(s);
+      return nullptr;
+    }
+    return s;
+  }
+
+  // whether put() may place the stone: every cell inside and free, whatever
+  // the neighbours.
+  bool fits(const Put &put) const {
+    if (put.id >= g->stone_pattern_vector.size() || isUsed(put.id)) {
+      return false;
+    }
+    if (put.r < 0 || put.r >= 8) return false;
+    const auto &stone = g->stone_pattern_vector[put.id][put.r];
+    if (stone.empty()) return false;
+    for (const auto &pos : stone) {
+      const int x = put.x + pos.x, y = put.y + pos.y;
+      if (!isInsideField(x, y) || !isEmpty(x, y)) return false;
+    }
+    return true;
+  }
+
+  SolverAnswer toAnswer() const {
+    TraceSpan span("toAnswer");
+    GameState *s = this->clone();
+    SolverAnswerBuilder builder(g->problem);
+    s->transDefault();
+    const auto log =
+        backCalcPutList(s->getField(), s->getBitField(), s->getUsedMask());
+    for (const auto &put : log) {
+      const int x = put.x - g->stone_pattern_origin[put.id][put.r].x;
+      const int y = put.y - g->stone_pattern_origin[put.id][put.r].y;
+      builder.put(put.id, x, y, put.r / 4, put.r % 4);
+    }
+    GameState::free(s);
+    return builder.build();
+  }
+
+  // the puts of an answer in orientation 0, in its order; the inverse of
+  // toAnswer.
+  static vector<Put> fromAnswer(const SolverAnswer &answer) {
+    vector<Put> puts;
+    for (const auto &a : answer.put_list) {
+      const int j = a.flip * 4 + a.rotate;
+      const auto &origin = g->stone_pattern_origin[a.stone_index][j];
+      puts.emplace_back(a.stone_index, a.x + origin.x, a.y + origin.y,
+                        g->stone_pattern_alias[a.stone_index][j]);
+    }
+    return puts;
+  }
+
+  vector<Put> getAvailableList(int x, int y) const {
+    vector<Put> ret;
+    bitset<256 * 8> bits;
+    for (int u = 0; u < 8; ++u) {
+      for (int v = -7; v < 8; ++v) {
+        const int ny = y + u;
+        const int nx = x + v;
+        if (isInsideField(nx, ny) && isEmpty(nx, ny))
+          ;
+        else {
+          bits |= g->stone_pattern_mask[u][v + 8];
+        }
+      }
+    }
+
+    for (int i = 0; i < 256 * 8; ++i) {
+      if (used_[i / 8]) {
+        continue;
+      } else if (bits[i]) {
+        PROCON26_COUNT(kMaskRejected);
+        continue;
+      } else {
+        Put p = Put(i / 8, x, y, i % 8);
+        if (available(p)) {
+          ret.push_back(p);
+        }
+      }
+    }
+    return std::move(ret);
+  }
+
+  bool available(const Put &put, bool reverse = false) const {
+    PROCON26_COUNT(kAvailable);
+    if (g->stone_pattern_vector.size() <= put.id) return false;
+    if (isUsed(put.id)) return false;
+    if (g->stone_pattern_vector[put.id][put.r].empty()) return false;
+    bool ok = isFirstStone();
+    for (auto pos : g->stone_pattern_vector[put.id][put.r]) {
+      if (isInsideField(put.x + pos.x, put.y + pos.y) &&
+          isEmpty(put.x + pos.x, put.y + pos.y))
+        ;
+      else
+        return false;
+      if (!ok) {
+        for (int r = 0; r < 4; ++r) {
+          const int x = put.x + dx[r];
+          const int y = put.y + dy[r];
+          if (isInsideField(x, y) && isStone(x, y)) {
+            if (!reverse && field_[y][x] < put.id) {
+              ok = true;
+            }
+            if (reverse && field_[y][x] > put.id) {
+              ok = true;
+            }
+          }
+        }
+      }
+    }
+    return ok;
+  }
+
+  void put(const Put &put) {
+    const auto &stone = g->stone_pattern_vector[put.id][put.r];
+    const auto size = stone.size();
+    assert(size);
+    for (const auto &pos : stone) {
+      const auto p = Point(put.x + pos.x, put.y + pos.y);
+      assert(field_[p.y][p.x] == 0);
+      assert(!bit_field_[p.to1d()]);
+      field_[p.y][p.x] = put.id;
+      bit_field_[p.to1d()] = 1;
+      const auto q = Transform::trans(trans_state_, 0, p);
+      hash_value_ ^= FieldHash::get(q.x, q.y, size);
+    }
+    assert(!used_[put.id]);
+    used_[put.id] = 1;
+    empty_count_ -= size;
+  }
+
+  void undo(const Put &put) {
+    const auto &stone = g->stone_pattern_vector[put.id][put.r];
+    const auto size = stone.size();
+    assert(size);
+    for (const auto &pos : stone) {
+      const auto p = Point(put.x + pos.x, put.y + pos.y);
+      assert(field_[p.y][p.x] == put.id);
+      assert(bit_field_[p.to1d()]);
+      field_[p.y][p.x] = 0;
+      bit_field_[p.to1d()] = 0;
+      const auto q = Transform::trans(trans_state_, 0, p);
+      hash_value_ ^= FieldHash::get(q.x, q.y, size);
+    }
+    assert(used_[put.id]);
+    used_[put.id] = 0;
+    empty_count_ += size;
+  }
+
+  uint32_t preHash(const Put &put) const {
+    uint32_t hash = hash_value_;
+    const auto &stone = g->stone_pattern_vector[put.id][put.r];
+    const auto size = stone.size();
+    for (const auto &pos : stone) {
+      const auto q =
+          Transform::trans(trans_state_, 0, put.x + pos.x, put.y + pos.y);
+      hash ^= FieldHash::get(q.x, q.y, size);
+    }
+    return hash;
+  }
+
+  int calcSimpleScore(const Put &put) const {
+    int score = 0;
+    const auto &stone = g->stone_pattern_vector[put.id][put.r];
+    score += stone.size() * stone.size();
+    if (isFirstStone()) {
+      score -= (int)put.id * put.id;
+    } else {
+      int min_around_id = 255;
+      for (const auto &pos : stone) {
+        for (int r = 0; r < 4; ++r) {
+          const int x = pos.x + put.x + dx[r];
+          const int y = pos.y + put.y + dy[r];
+          if (isInsideField(x, y)) {
+            if (isStone(x, y) && field_[y][x] < put.id) {
+              min_around_id = min(min_around_id, (int)field_[y][x]);
+            }
+          }
+        }
+      }
+      score -= g->weight_diff_id * (put.id - min_around_id);
+    }
+    return score;
+  }
+
+  void gvField() const;
+
+  void trans(int to) {
+    assert(to >= 0 && to < 8);
+    if (trans_state_ == to) return;
+    field_.transform(trans_state_, to);
+    bit_field_.transform(trans_state_, to);
+    trans_state_ = to;
+  }
+  void trans() { trans((trans_state_ + 1) % 8); }
+  void transDefault() { trans(0); }
+  void transRotate(int r) {
+    trans((trans_state_ >= 4) * 4 + (trans_state_ + r) % 4);
+  }
+  uint8_t getTransState() const { return trans_state_; }
+  const Field &getField() const { return field_; }
+  const BitField &getBitField() const { return bit_field_; }
+  const UsedMask &getUsedMask() const { return used_; }
+  bool isFirstStone() const { return !used_.any(); }
+  bool isUsed(int i) const { return used_[i]; }
+  int getEmptyCount() const { return empty_count_; }
+  void addScore(int score) { score_ += score; };
+  int getScore() const { return score_; }
+  uint32_t getHash() const { return hash_value_; }
+  bool isStone(int x, int y) const {
+    assert(isInsideField(x, y));
+    return bit_field_[y << 5 | x];
+  }
+  bool isBlock(int x, int y) const {
+    assert(isInsideField(x, y));
+    return g->default_field[trans_state_][y][x];
+  }
+  bool isEmpty(int x, int y) const {
+    assert(isInsideField(x, y));
+    return bit_field_[y << 5 | x] == 0 &&
+           g->default_field[trans_state_][y][x] == 0;
+  }
+};
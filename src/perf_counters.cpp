@@ -0,0 +1,128 @@
+﻿/*
+The MIT License (MIT)
+
+Copyright (c) 2015 Shingo INADA
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#include "perf_counters.hpp"
+#include <cstring>
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+const char *const kPerfEventName[kPerfEventCount] = {
+    "cycles", "instructions", "cache_misses", "branch_misses", "dtlb_misses"};
+
+#ifdef __linux__
+int openEvent(int event) {
+  perf_event_attr attr;
+  memset(&attr, 0, sizeof(attr));
+  attr.size = sizeof(attr);
+  attr.type = PERF_TYPE_HARDWARE;
+  switch (event) {
+    case kCycles:
+      attr.config = PERF_COUNT_HW_CPU_CYCLES;
+      break;
+    case kInstructions:
+      attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+      break;
+    case kCacheMisses:
+      attr.config = PERF_COUNT_HW_CACHE_MISSES;
+      break;
+    case kBranchMisses:
+      attr.config = PERF_COUNT_HW_BRANCH_MISSES;
+      break;
+    case kDtlbMisses:
+      attr.type = PERF_TYPE_HW_CACHE;
+      attr.config = PERF_COUNT_HW_CACHE_DTLB |
+                    PERF_COUNT_HW_CACHE_OP_READ << 8 |
+                    PERF_COUNT_HW_CACHE_RESULT_MISS << 16;
+      break;
+  }
+  attr.disabled = 1;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  attr.read_format =
+      PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+  // this thread on any cpu.
+  return (int)syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+}
+#endif
+
+}  // namespace
+
+PerfCounters::PerfCounters() {
+  for (int i = 0; i < kPerfEventCount; ++i) {
+#ifdef __linux__
+    fd_[i] = openEvent(i);
+#else
+    fd_[i] = -1;
+#endif
+  }
+}
+
+PerfCounters::~PerfCounters() {
+#ifdef __linux__
+  for (int fd : fd_) {
+    if (fd >= 0) close(fd);
+  }
+#endif
+}
+
+bool PerfCounters::available() const {
+  for (int fd : fd_) {
+    if (fd >= 0) return true;
+  }
+  return false;
+}
+
+void PerfCounters::start() {
+#ifdef __linux__
+  for (int fd : fd_) {
+    if (fd < 0) continue;
+    ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+    ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+  }
+#endif
+}
+
+PerfSample PerfCounters::stop() {
+  PerfSample sample;
+  for (int i = 0; i < kPerfEventCount; ++i) {
+    sample.value[i] = -1;
+#ifdef __linux__
+    if (fd_[i] < 0) continue;
+    ioctl(fd_[i], PERF_EVENT_IOC_DISABLE, 0);
+    uint64_t v[3];  // value, time enabled, time running
+    if (read(fd_[i], v, sizeof(v)) != sizeof(v)) continue;
+    sample.value[i] =
+        v[2] ? (int64_t)((double)v[0] * v[1] / v[2]) : (int64_t)v[0];
+#endif
+  }
+  return sample;
+}
+
+const char *PerfCounters::name(int event) { return kPerfEventName[event]; }
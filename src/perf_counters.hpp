@@ -0,0 +1,64 @@
+﻿/*
+The MIT License (MIT)
+
+Copyright (c) 2015 Shingo INADA
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#pragma once
+
+#include <cstdint>
+
+// Hardware counters of the calling thread through perf_event_open. Events
+// the kernel or perf_event_paranoid refuses read as -1, so callers fall
+// back to their own timers.
+enum PerfEvent {
+  kCycles,
+  kInstructions,
+  kCacheMisses,
+  kBranchMisses,
+  kDtlbMisses,  // data TLB read misses
+  kPerfEventCount
+};
+
+struct PerfSample {
+  int64_t value[kPerfEventCount];  // -1 when the event is unavailable
+};
+
+class PerfCounters {
+ public:
+  PerfCounters();
+  ~PerfCounters();
+  PerfCounters(const PerfCounters &) = delete;
+  PerfCounters &operator=(const PerfCounters &) = delete;
+
+  // true when at least one event could be opened.
+  bool available() const;
+
+  void start();
+
+  // counts since start(), scaled up when the kernel multiplexed an event.
+  PerfSample stop();
+
+  static const char *name(int event);
+
+ private:
+  int fd_[kPerfEventCount];
+};
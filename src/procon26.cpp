@@ -0,0 +1,132 @@
+﻿/*
+The MIT License (MIT)
+
+Copyright (c) 2015 Shingo INADA
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#include "procon26.hpp"
+#include "sample_solver.hpp"
+#define GV_JS
+// #define DISABLE_GV
+#include "gv.hpp"
+
+// gv writes to one global file, so library users opt in explicitly.
+static struct GvDefault {
+  GvDefault() { gvSetEnable(false); }
+} gv_default;
+
+void GameState::gvField() const {
+  int count = 0;
+  for (int y = 0; y < 32; y++) {
+    for (int x = 0; x < 32; x++) {
+      if (g->default_field[trans_state_][y][x]) {
+        if (bit_field_[y << 5 | x]) {
+          gvRect(x, y, 1, 1, gvRGB(128, 0, 0));
+        } else {
+          count++;
+          gvRect(x, y, 1, 1, gvRGB(0));
+        }
+      } else if (bit_field_[y << 5 | x]) {
+        count++;
+        gvRect(x, y, 1, 1, gvColor(field_[y][x]));
+        gvText(x + 0.5, y + 0.5, 0.2, gvRGB(0, 0, 0), "%d", field_[y][x]);
+      }
+    }
+  }
+  gvText(10, -1, "%d/1024", count);
+  gvRect(-20, 0, 19, 32, gvRGB(0xEEEEEE));
+  int Y = 0;
+  gvText(-10, Y++, "put_size = %d", used_.count());
+  gvText(-10, Y++, "trans_state = %d", trans_state_);
+  int cnt[17] = {0};
+  for (int i = 0; i < g->stone_pattern_vector.size(); ++i) {
+    if (!isUsed(i)) {
+      cnt[g->stone_pattern_vector[i][0].size()]++;
+    }
+  }
+  for (int i = 1; i <= 16; ++i) {
+    gvText(-10, Y++, "%2d %3d", i, cnt[i]);
+  }
+}
+
+void SampleSolver::visualize(GameState &best_state) {
+  if (!g_gvEnableFlag) return;
+  gvInit();
+  best_state.gvField();
+  gvNewTime();
+
+  auto vis = GameState::alloc()->init();
+  best_state.transDefault();
+  for (auto put :
+       backCalcPutList(best_state.getField(), best_state.getBitField(),
+                       best_state.getUsedMask())) {
+    vis->put(put);
+    vis->gvField();
+    gvNewTime();
+  }
+  GameState::free(vis);
+}
+
+struct Solver::Impl {
+  Problem problem;
+  SolverParameter parameter;
+  SampleSolver solver;
+
+  Impl(const Problem &problem, const SolverParameter &parameter)
+      : problem(problem), parameter(parameter), solver(this->problem,
+                                                       this->parameter) {}
+};
+
+Solver::Solver(const Problem &problem, const SolverParameter &parameter)
+    : impl_(new Impl(problem, parameter)) {}
+
+Solver::~Solver() {}
+
+void Solver::onAnswer(
+    std::function<void(const SolverAnswer &, int, int)> callback) {
+  impl_->solver.on_answer = std::move(callback);
+}
+
+void Solver::onProgress(
+    std::function<void(const SolverProgress &)> callback) {
+  impl_->solver.on_progress = std::move(callback);
+}
+
+SolverAnswer Solver::run() { return impl_->solver.run(); }
+
+void Solver::cancel() { impl_->solver.cancel(); }
+
+SolverStats Solver::stats() const { return impl_->solver.stats(); }
+
+Solver::Async Solver::runAsync() {
+  Async async;
+  async.impl_ = impl_;
+  auto impl = impl_;
+  impl->solver.clearCancel();
+  async.future_ = std::async(std::launch::async, [impl]() {
+    return impl->solver.runKeepingCancel();
+  }).share();
+  return async;
+}
+
+void Solver::Async::cancel() { impl_->solver.cancel(); }
+
+void Solver::setVisualization(bool enable) { gvSetEnable(enable); }
@@ -0,0 +1,1620 @@
+﻿/*
+The MIT License (MIT)
+
+Copyright (c) 2015 Shingo INADA
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <ctime>
+#include <functional>
+#include <memory>
+#include <queue>
+#include <thread>
+#include <google/dense_hash_map>
+#include <pthread.h>
+#include <signal.h>
+#include <unistd.h>
+#include "game_state.hpp"
+#include "perf_counters.hpp"
+#include "trace.hpp"
+
+// Beam bucket stored as parallel arrays. Selection only reads the contiguous
+// score/hash columns and never touches the scattered GameState blocks.
+// Once `capacity` states are held, the slots form a min-heap on score and a
+// new state replaces the worst one, so a bucket never outgrows the beam.
+// Ties on score go to the earlier arrival, so what a bucket keeps does not
+// depend on the order its states were pushed in (see SpillBucket::drain).
+struct StateBucket {
+  vector<int32_t> score;
+  vector<uint32_t> hash;
+  vector<GameState *> state;
+  vector<uint64_t> arrival;  // push number within the beam search
+
+  explicit StateBucket(int capacity = std::numeric_limits<int>::max())
+      : capacity_(capacity) {}
+
+  bool empty() const { return state.empty(); }
+  int size() const { return static_cast<int>(state.size()); }
+  size_t bytes() const {
+    return score.capacity() * sizeof(int32_t) +
+           hash.capacity() * sizeof(uint32_t) +
+           state.capacity() * sizeof(GameState *) +
+           arrival.capacity() * sizeof(uint64_t) +
+           heap_.capacity() * sizeof(int);
+  }
+
+  // lower the capacity, dropping the worst states beyond it.
+  void shrink(int capacity) {
+    if (capacity >= capacity_) return;
+    capacity_ = capacity;
+    selectTop(capacity_);
+    reheap();
+  }
+
+  // whether a state with score `s` that arrived `n`-th would be kept. A new
+  // arrival comes after every held state, so it loses ties.
+  bool admits(int32_t s,
+              uint64_t n = std::numeric_limits<uint64_t>::max()) const {
+    if (size() < capacity_) return true;
+    const int worst = heap_.front();
+    return s > score[worst] || (s == score[worst] && n < arrival[worst]);
+  }
+
+  void push(GameState *s, uint64_t n) {
+    if (size() < capacity_) {
+      score.push_back(s->getScore());
+      hash.push_back(s->getHash());
+      state.push_back(s);
+      arrival.push_back(n);
+      if (size() == capacity_) reheap();
+      return;
+    }
+    assert(admits(s->getScore(), n));
+    std::pop_heap(heap_.begin(), heap_.end(), heapOrder());
+    const int slot = heap_.back();
+    GameState::free(state[slot]);
+    score[slot] = s->getScore();
+    hash[slot] = s->getHash();
+    state[slot] = s;
+    arrival[slot] = n;
+    std::push_heap(heap_.begin(), heap_.end(), heapOrder());
+  }
+
+  // put the states in arrival order, the order they are expanded in.
+  void sortByArrival() {
+    vector<int> order(size());
+    for (int i = 0; i < size(); ++i) order[i] = i;
+    std::sort(order.begin(), order.end(),
+              [this](int x, int y) { return arrival[x] < arrival[y]; });
+    StateBucket sorted(capacity_);
+    for (int i : order) {
+      sorted.score.push_back(score[i]);
+      sorted.hash.push_back(hash[i]);
+      sorted.state.push_back(state[i]);
+      sorted.arrival.push_back(arrival[i]);
+    }
+    score.swap(sorted.score);
+    hash.swap(sorted.hash);
+    state.swap(sorted.state);
+    arrival.swap(sorted.arrival);
+    reheap();
+  }
+
+  // drop states whose score is lower than a known state with the same hash.
+  // This prunes more than the original search, which only skipped children
+  // already beaten in the duplicate table, so it is opt-in (-ex dedup 1).
+  template <class HashMap>
+  void dropDominated(const HashMap &best_score) {
+    int j = 0;
+    for (int i = 0; i < size(); ++i) {
+      PROCON26_COUNT(kHashProbe);
+      auto it = best_score.find(hash[i]);
+      if (it != best_score.end() && it->second > score[i]) {
+        GameState::free(state[i]);
+      } else {
+        move(i, j++);
+      }
+    }
+    resize(j);
+    reheap();
+  }
+
+  // keep the top `width` scores, earlier arrivals first on ties, and return
+  // the others to the pool.
+  void selectTop(int width) {
+    if (size() <= width) return;
+    vector<int> rank(size());
+    for (int i = 0; i < size(); ++i) rank[i] = i;
+    std::nth_element(rank.begin(), rank.begin() + (width - 1), rank.end(),
+                     heapOrder());
+    const int last = rank[width - 1];
+    const auto better = heapOrder();
+    int j = 0;
+    for (int i = 0; i < size(); ++i) {
+      if (i == last || better(i, last)) {
+        move(i, j++);
+      } else {
+        GameState::free(state[i]);
+      }
+    }
+    resize(j);
+    reheap();
+  }
+
+  // return every state to the pool.
+  void clear() {
+    for (auto *s : state) GameState::free(s);
+    release();
+  }
+
+  void release() {
+    vector<int32_t>().swap(score);
+    vector<uint32_t>().swap(hash);
+    vector<GameState *>().swap(state);
+    vector<uint64_t>().swap(arrival);
+    vector<int>().swap(heap_);
+  }
+
+ private:
+  // x before y when x is the better state, so the heap front is the worst.
+  struct HeapOrder {
+    const StateBucket *b;
+    bool operator()(int x, int y) const {
+      if (b->score[x] != b->score[y]) return b->score[x] > b->score[y];
+      return b->arrival[x] < b->arrival[y];
+    }
+  };
+  HeapOrder heapOrder() const { return {this}; }
+
+  void move(int from, int to) {
+    score[to] = score[from];
+    hash[to] = hash[from];
+    state[to] = state[from];
+    arrival[to] = arrival[from];
+  }
+  void resize(int n) {
+    score.resize(n);
+    hash.resize(n);
+    state.resize(n);
+    arrival.resize(n);
+  }
+  void reheap() {
+    heap_.clear();
+    if (size() < capacity_) return;
+    heap_.resize(size());
+    for (int i = 0; i < size(); ++i) heap_[i] = i;
+    std::make_heap(heap_.begin(), heap_.end(), heapOrder());
+  }
+
+  int capacity_;
+  vector<int> heap_;
+};
+
+// Pending bucket kept on disk as compact records (-ex spill <dir>). Only the
+// admission heap of scores stays in memory; the records are read back through
+// mmap when the beam search reaches the level. Each record is preceded by
+// its arrival number, so the bucket it is drained into breaks ties as if it
+// had been held in memory all along. Records the heap has since evicted are
+// dropped by rewriting the file whenever they make up half of it, so the
+// file stays within about twice the beam width.
+class SpillBucket {
+ public:
+  SpillBucket() = default;
+  SpillBucket(const SpillBucket &) = delete;
+  ~SpillBucket() {
+    if (file_) {
+      fclose(file_);
+      unlink(path_.c_str());
+    }
+  }
+
+  void open(const string &path, int capacity) {
+    path_ = path;
+    capacity_ = capacity;
+    compact_at_ = 2 * (size_t)capacity;
+  }
+
+  bool empty() const { return count_ == 0; }
+  size_t bytes() const { return heap_.capacity() * sizeof(int32_t); }
+
+  bool admits(int32_t s) const {
+    return (int)heap_.size() < capacity_ || s > heap_.front();
+  }
+
+  void push(const GameState &s, uint64_t arrival) {
+    if (!file_) {
+      file_ = fopen(path_.c_str(), "wb+");
+      if (!file_) {
+        throw SolverError("cannnot open the spill file. " + path_);
+      }
+    }
+    buf_.resize(sizeof(arrival));
+    memcpy(buf_.data(), &arrival, sizeof(arrival));
+    s.encode(buf_);
+    if (fwrite(buf_.data(), 1, buf_.size(), file_) != buf_.size()) {
+      throw SolverError("cannnot write the spill file. " + path_);
+    }
+    count_++;
+    if ((int)heap_.size() < capacity_) {
+      heap_.push_back(s.getScore());
+      std::push_heap(heap_.begin(), heap_.end(), std::greater<int32_t>());
+    } else {
+      std::pop_heap(heap_.begin(), heap_.end(), std::greater<int32_t>());
+      heap_.back() = s.getScore();
+      std::push_heap(heap_.begin(), heap_.end(), std::greater<int32_t>());
+      if (count_ >= compact_at_) compact();
+    }
+  }
+
+  void shrink(int capacity) {
+    capacity_ = min(capacity_, capacity);
+    while ((int)heap_.size() > capacity_) {
+      std::pop_heap(heap_.begin(), heap_.end(), std::greater<int32_t>());
+      heap_.pop_back();
+    }
+    compact_at_ = min(compact_at_, 2 * (size_t)capacity_);
+  }
+
+  size_t size() const { return count_; }
+
+  // pass every record, undecoded and in arrival order, to f(record, bytes).
+  template <class F>
+  void scan(F f) {
+    mapRecords([&f](const uint8_t *&p) {
+      p += sizeof(uint64_t);
+      StateRecord r;
+      memcpy(&r, p, sizeof(r));
+      f(p, r.size());
+      p += r.size();
+    });
+  }
+
+  // decode the records that can still be within the top `capacity` and pass
+  // them to f(state, arrival), then remove the file.
+  template <class F>
+  void drain(F f) {
+    const int32_t cutoff = (int)heap_.size() < capacity_
+                               ? std::numeric_limits<int32_t>::min()
+                               : heap_.front();
+    mapRecords([&f, cutoff](const uint8_t *&p) {
+      uint64_t arrival;
+      memcpy(&arrival, p, sizeof(arrival));
+      p += sizeof(arrival);
+      StateRecord r;
+      memcpy(&r, p, sizeof(r));
+      if (r.score >= cutoff) {
+        f(GameState::decode(p), arrival);
+      } else {
+        p += r.size();
+      }
+    });
+    if (!file_) return;
+    fclose(file_);
+    unlink(path_.c_str());
+    file_ = nullptr;
+    count_ = 0;
+    vector<int32_t>().swap(heap_);
+  }
+
+ private:
+  // keep only the records at or above the admission cutoff. Records tied
+  // at the cutoff may leave more than capacity_, so the next rewrite waits
+  // until the file has doubled again.
+  void compact() {
+    const int32_t cutoff = heap_.front();
+    const string tmp = path_ + ".tmp";
+    FILE *out = fopen(tmp.c_str(), "wb+");
+    if (!out) throw SolverError("cannnot open the spill file. " + tmp);
+    size_t kept = 0;
+    bool ok = true;
+    mapRecords([out, cutoff, &kept, &ok](const uint8_t *&p) {
+      StateRecord r;
+      memcpy(&r, p + sizeof(uint64_t), sizeof(r));
+      const size_t n = sizeof(uint64_t) + r.size();
+      if (r.score >= cutoff) {
+        ok = ok && fwrite(p, 1, n, out) == n;
+        kept++;
+      }
+      p += n;
+    });
+    if (!ok || rename(tmp.c_str(), path_.c_str()) != 0) {
+      fclose(out);
+      unlink(tmp.c_str());
+      throw SolverError("cannnot write the spill file. " + tmp);
+    }
+    fclose(file_);
+    file_ = out;
+    count_ = kept;
+    compact_at_ = 2 * max(kept, (size_t)capacity_);
+  }
+
+  template <class F>
+  void mapRecords(F f) {
+    if (!file_) return;
+    fflush(file_);
+    const size_t len = ftell(file_);
+    void *m = mmap(nullptr, len, PROT_READ, MAP_PRIVATE, fileno(file_), 0);
+    if (m == MAP_FAILED) {
+      throw SolverError("cannnot map the spill file. " + path_);
+    }
+    madvise(m, len, MADV_SEQUENTIAL);
+    const uint8_t *p = static_cast<const uint8_t *>(m);
+    const uint8_t *end = p + len;
+    while (p < end) f(p);
+    munmap(m, len);
+  }
+
+  string path_;
+  FILE *file_ = nullptr;
+  size_t count_ = 0;
+  size_t compact_at_ = 0;  // record count that triggers the next compact()
+  int capacity_ = 0;
+  vector<int32_t> heap_;
+  vector<uint8_t> buf_;
+};
+
+// Results kept on disk per problem (-ex cache <dir>). <hash>.txt holds the
+// best answer's counts with the configuration that produced it and every
+// configuration already run; <hash>.ans holds the best answer itself.
+class ResultCache {
+ public:
+  struct Config {
+    int trans, beam_width, weight;
+    string options;  // the other search options, see searchOptions()
+    bool operator==(const Config &o) const {
+      return trans == o.trans && beam_width == o.beam_width &&
+             weight == o.weight && options == o.options;
+    }
+  };
+  struct Run {
+    Config config;
+    double seconds;
+  };
+
+  ResultCache(const string &dir, uint64_t problem_hash) {
+    char name[32];
+    snprintf(name, sizeof(name), "%016llx",
+             static_cast<unsigned long long>(problem_hash));
+    path_ = dir + "/" + name;
+    ifstream ifs(path_ + ".txt");
+    string key;
+    while (ifs >> key) {
+      if (key == "best") {
+        ifs >> best_empty >> best_stones >> best_config.trans >>
+            best_config.beam_width >> best_config.weight;
+        readOptions(ifs, best_config.options);
+      } else if (key == "run") {
+        Run r;
+        ifs >> r.config.trans >> r.config.beam_width >> r.config.weight >>
+            r.seconds;
+        readOptions(ifs, r.config.options);
+        runs_.push_back(r);
+      }
+    }
+  }
+
+  bool hasAnswer() const { return best_empty <= 1024; }
+  string answerFile() const { return path_ + ".ans"; }
+  bool hasRun(const Config &c) const {
+    for (const auto &r : runs_)
+      if (r.config == c) return true;
+    return false;
+  }
+  double seconds() const {
+    double sum = 0;
+    for (const auto &r : runs_) sum += r.seconds;
+    return sum;
+  }
+
+  void addRun(const Config &c, double seconds) {
+    runs_.push_back({c, seconds});
+    save();
+  }
+
+  // store the answer if it beats the cached one.
+  void update(const Problem &problem, const SolverAnswer &answer, int empty,
+              int stones, const Config &c) {
+    if (empty > best_empty || (empty == best_empty && stones >= best_stones))
+      return;
+    best_empty = empty;
+    best_stones = stones;
+    best_config = c;
+    {
+      ofstream ofs(path_ + ".ans.tmp");
+      SolverAnswerWriter(problem, answer).write(ofs);
+    }
+    rename((path_ + ".ans.tmp").c_str(), answerFile().c_str());
+    save();
+  }
+
+  int best_empty = 1025;
+  int best_stones = 0;
+  Config best_config = {0, 0, 0, ""};
+
+ private:
+  // the rest of the line; files written before options were kept have
+  // none, which matches runs without extra search options.
+  static void readOptions(istream &is, string &options) {
+    getline(is, options);
+    options.erase(0, options.find_first_not_of(' '));
+  }
+
+  void save() {
+    {
+      ofstream ofs(path_ + ".txt.tmp");
+      if (hasAnswer()) {
+        ofs << "best " << best_empty << " " << best_stones << " "
+            << best_config.trans << " " << best_config.beam_width << " "
+            << best_config.weight;
+        if (!best_config.options.empty()) ofs << " " << best_config.options;
+        ofs << "\n";
+      }
+      for (const auto &r : runs_) {
+        ofs << "run " << r.config.trans << " " << r.config.beam_width << " "
+            << r.config.weight << " " << r.seconds;
+        if (!r.config.options.empty()) ofs << " " << r.config.options;
+        ofs << "\n";
+      }
+    }
+    rename((path_ + ".txt.tmp").c_str(), (path_ + ".txt").c_str());
+  }
+
+  string path_;
+  vector<Run> runs_;
+};
+
+// Starts a background thread of the solver with SIGTERM and SIGINT blocked,
+// so a handler the application installs for them always runs on the thread
+// that called run(). The mask is inherited from the creating thread, which
+// leaves no window in which the new thread could take the signal.
+template <class F>
+thread startHelperThread(F f) {
+  sigset_t set, old;
+  sigemptyset(&set);
+  sigaddset(&set, SIGTERM);
+  sigaddset(&set, SIGINT);
+  pthread_sigmask(SIG_BLOCK, &set, &old);
+  thread t(std::move(f));
+  pthread_sigmask(SIG_SETMASK, &old, nullptr);
+  return t;
+}
+
+// Writes <prefix>NNNN_MMM.ans files on a background thread. A file is
+// written under a ".tmp_" name that submit.sh's "*.ans*" does not match,
+// then renamed into place. A posted answer replaces one that has not been
+// written yet.
+class AnswerWriter {
+ public:
+  AnswerWriter(const Problem &problem, const string &prefix)
+      : problem_(problem),
+        prefix_(prefix),
+        thread_(startHelperThread([this]() { loop(); })) {}
+
+  ~AnswerWriter() {
+    {
+      lock_guard<mutex> lock(mutex_);
+      stop_ = true;
+    }
+    cv_.notify_one();
+    thread_.join();
+  }
+
+  void post(SolverAnswer answer, int empty, int stones) {
+    {
+      lock_guard<mutex> lock(mutex_);
+      answer_ = std::move(answer);
+      empty_ = empty;
+      stones_ = stones;
+      pending_ = true;
+    }
+    cv_.notify_one();
+  }
+
+ private:
+  void loop() {
+    unique_lock<mutex> lock(mutex_);
+    for (;;) {
+      cv_.wait(lock, [this]() { return pending_ || stop_; });
+      if (!pending_) return;
+      SolverAnswer answer = std::move(answer_);
+      const int empty = empty_, stones = stones_;
+      pending_ = false;
+      lock.unlock();
+      write(answer, empty, stones);
+      lock.lock();
+    }
+  }
+
+  void write(const SolverAnswer &answer, int empty, int stones) {
+    char name[64], tmp_name[64];
+    sprintf(name, "%04d_%03d.ans", empty, stones);
+    if (name == last_name_) return;
+    TraceSpan span("writeAnswer");
+    span.arg("empty", empty);
+    span.arg("stones", stones);
+    last_name_ = name;
+    sprintf(tmp_name, ".tmp_%04d_%03d_%d", empty, stones, (int)getpid());
+    const string tmp = prefix_ + tmp_name;
+    {
+      ofstream ofs(tmp);
+      SolverAnswerWriter(problem_, answer).write(ofs);
+    }
+    rename(tmp.c_str(), (prefix_ + name).c_str());
+  }
+
+  const Problem &problem_;
+  const string prefix_;
+  mutex mutex_;
+  condition_variable cv_;
+  SolverAnswer answer_;
+  int empty_ = 0, stones_ = 0;
+  bool pending_ = false;
+  bool stop_ = false;
+  string last_name_;
+  thread thread_;
+};
+
+// Counters of one beam search level.
+struct LevelStats {
+  int trans = 0;
+  int level = 0;          // empty cells of the bucket
+  size_t in = 0;          // states in the bucket, spilled ones included
+  size_t unique = 0;      // after dropping duplicate hashes
+  size_t kept = 0;        // after cutting to the beam width
+  size_t children = 0;    // puts generated from the kept states
+  size_t duplicates = 0;  // children dominated in the duplicate table
+  size_t rejects = 0;     // children no bucket admitted
+  double seconds = 0;
+  PerfSample perf{};      // hardware counters of the level, -1 if unavailable
+};
+
+// `-ex stats file`: one line per level, CSV when the file name ends in
+// ".csv" and JSONL otherwise. Lines are buffered, not flushed. Hardware
+// counters are left empty in CSV and out of JSONL when unavailable.
+class StatsSink {
+ public:
+  explicit StatsSink(const string &file) : ofs_(file) {
+    if (!ofs_) {
+      throw SolverError("cannnot open the stats file. " + file);
+    }
+    csv_ = file.size() >= 4 && file.compare(file.size() - 4, 4, ".csv") == 0;
+    if (csv_) {
+      ofs_ << "trans,level,in,unique,kept,children,duplicates,rejects,"
+              "branching,seconds";
+      for (int i = 0; i < kPerfEventCount; ++i) {
+        ofs_ << "," << PerfCounters::name(i);
+      }
+      ofs_ << "\n";
+    }
+  }
+
+  void write(const LevelStats &s) {
+    const double branching = s.kept ? (double)s.children / s.kept : 0;
+    if (csv_) {
+      ofs_ << s.trans << "," << s.level << "," << s.in << "," << s.unique
+           << "," << s.kept << "," << s.children << "," << s.duplicates << ","
+           << s.rejects << "," << branching << "," << s.seconds;
+      for (int64_t v : s.perf.value) {
+        ofs_ << ",";
+        if (v >= 0) ofs_ << v;
+      }
+      ofs_ << "\n";
+    } else {
+      ofs_ << "{\"trans\":" << s.trans << ",\"level\":" << s.level
+           << ",\"in\":" << s.in << ",\"unique\":" << s.unique
+           << ",\"kept\":" << s.kept << ",\"children\":" << s.children
+           << ",\"duplicates\":" << s.duplicates
+           << ",\"rejects\":" << s.rejects << ",\"branching\":" << branching
+           << ",\"seconds\":" << s.seconds;
+      for (int i = 0; i < kPerfEventCount; ++i) {
+        if (s.perf.value[i] < 0) continue;
+        ofs_ << ",\"" << PerfCounters::name(i) << "\":" << s.perf.value[i];
+      }
+      ofs_ << "}\n";
+    }
+  }
+
+ private:
+  ofstream ofs_;
+  bool csv_;
+};
+
+// `-ex heartbeat file`: a monitor thread rewrites `file` with one JSON
+// object every heartbeat_interval ms (1000 by default) for dashboards to
+// poll. The solver only stores a few atomics per level and per improvement;
+// states/s, memory and the projected finish of the remaining orientations
+// are worked out on the monitor side.
+class Heartbeat {
+ public:
+  Heartbeat(const string &file, chrono::milliseconds interval,
+            int first_trans)
+      : file_(file),
+        interval_(interval),
+        orientations_(8 - first_trans),
+        start_(chrono::steady_clock::now()),
+        last_beat_(start_),
+        thread_(startHelperThread([this]() { loop(); })) {}
+
+  ~Heartbeat() {
+    {
+      lock_guard<mutex> lock(mutex_);
+      stop_ = true;
+    }
+    cv_.notify_one();
+    thread_.join();
+    write(true);
+  }
+
+  // at the start of each level; `top` is the first level of the
+  // orientation and `expanded` counts states over the whole run.
+  void level(int trans, int level, int top, size_t expanded) {
+    trans_.store(trans, memory_order_relaxed);
+    level_.store(level, memory_order_relaxed);
+    top_.store(top, memory_order_relaxed);
+    expanded_.store(expanded, memory_order_relaxed);
+  }
+
+  void best(int empty, int stones) {
+    best_empty_.store(empty, memory_order_relaxed);
+    best_stones_.store(stones, memory_order_relaxed);
+  }
+
+  void orientationDone() { done_++; }
+
+ private:
+  void loop() {
+    unique_lock<mutex> lock(mutex_);
+    while (!cv_.wait_for(lock, interval_, [this]() { return stop_; })) {
+      lock.unlock();
+      write(false);
+      lock.lock();
+    }
+  }
+
+  void write(bool finished) {
+    const auto now = chrono::steady_clock::now();
+    const double elapsed = chrono::duration<double>(now - start_).count();
+    const double span = chrono::duration<double>(now - last_beat_).count();
+    const size_t expanded = expanded_.load(memory_order_relaxed);
+    const double rate = span > 0 ? (expanded - last_expanded_) / span : 0;
+    last_beat_ = now;
+    last_expanded_ = expanded;
+
+    // levels run from `top` down to 0, so the share of levels done stands
+    // in for the share of time spent in the current orientation.
+    const int top = top_.load(memory_order_relaxed);
+    const int level = level_.load(memory_order_relaxed);
+    const int done = done_.load();
+    double progress = done;
+    if (!finished && done < orientations_ && top > 0) {
+      progress += (double)(top - level) / top;
+    }
+    progress /= max(orientations_, 1);
+    const double eta =
+        finished ? 0 : progress > 0 ? elapsed * (1 - progress) / progress : -1;
+
+    const size_t mb = 1024 * 1024;
+    const string tmp = file_ + ".tmp";
+    {
+      ofstream ofs(tmp);
+      if (!ofs) return;
+      ofs << "{\"time\":" << time(nullptr) << ",\"elapsed_s\":" << elapsed
+          << ",\"trans\":" << trans_.load(memory_order_relaxed)
+          << ",\"level\":" << level << ",\"states_per_s\":" << rate
+          << ",\"expanded\":" << expanded
+          << ",\"best_empty\":" << best_empty_.load(memory_order_relaxed)
+          << ",\"best_stones\":" << best_stones_.load(memory_order_relaxed)
+          << ",\"memory_mb\":" << memory_budget.inUse() / mb
+          << ",\"slab_mb\":" << memory_budget.slab_bytes / mb
+          << ",\"orientations_done\":" << done
+          << ",\"orientations\":" << orientations_
+          << ",\"eta_s\":" << eta
+          << ",\"finished\":" << (finished ? "true" : "false") << "}\n";
+    }
+    rename(tmp.c_str(), file_.c_str());
+  }
+
+  const string file_;
+  const chrono::milliseconds interval_;
+  const int orientations_;
+  const chrono::steady_clock::time_point start_;
+  atomic<int> trans_{0}, level_{0}, top_{0};
+  atomic<size_t> expanded_{0};
+  atomic<int> best_empty_{1024}, best_stones_{0};
+  atomic<int> done_{0};
+  // monitor side only
+  chrono::steady_clock::time_point last_beat_;
+  size_t last_expanded_ = 0;
+  mutex mutex_;
+  condition_variable cv_;
+  bool stop_ = false;
+  thread thread_;
+};
+
+// Fixed part of a checkpoint file. It is followed by the best state record,
+// the pending buckets as (level, count, records...) terminated by level -1,
+// and the duplicate table as a count and (hash, score) pairs.
+struct CheckpointHeader {
+  char magic[4];
+  uint32_t version;
+  uint64_t problem_hash;
+  int32_t trans;
+  int32_t level;
+  int32_t beam_width;
+  int32_t weight;
+  int32_t best_trans;
+  uint32_t last_output_hash;
+};
+
+class SampleSolver {
+ public:
+  SampleSolver(const Problem &problem, SolverParameter &parameter)
+      : problem_(problem), parameter_(parameter) {
+    static atomic<int> next_id(0);
+    solver_id_ = next_id++;
+    hash_map.set_empty_key(0);
+  }
+
+  // called whenever a better answer has been built, with its empty cell and
+  // stone counts.
+  function<void(const SolverAnswer &, int, int)> on_answer;
+
+  // called on every best state improvement inside the beam search, which is
+  // far more often than on_answer.
+  function<void(const SolverProgress &)> on_progress;
+
+  // clears an earlier cancel() and solves.
+  SolverAnswer run() {
+    clearCancel();
+    return runKeepingCancel();
+  }
+
+  // for runAsync, which clears the flag on the caller's thread so that a
+  // cancel() right after it is not lost.
+  SolverAnswer runKeepingCancel() {
+    start_time_ = chrono::steady_clock::now();
+    stats_ = SolverStats();
+    g = &context_;
+    // recording covers this run only, also when it throws.
+    struct TraceRun {
+      bool on;
+      ~TraceRun() {
+        if (on) Trace::close();
+      }
+    } trace_run{parameter_.extra_parameter.find("trace") !=
+                parameter_.extra_parameter.end()};
+    if (trace_run.on) Trace::open(parameter_.extra_parameter["trace"]);
+    {
+      TraceSpan span("g.init");
+      g->init(problem_);
+    }
+    return solve();
+  }
+
+  // stop at the next bucket boundary; safe to call from any thread.
+  void cancel() { cancelled_ = true; }
+
+  void clearCancel() { cancelled_ = false; }
+
+  const SolverStats &stats() const { return stats_; }
+
+  // the cell to fill next: the first cell next to a stone in the smallest
+  // empty area. public for the micro benchmarks.
+  static vector<Point> getNextTargetPos(const GameState &state) {
+    uint16_t f[32][32] = {{0}};
+    int count = 0;
+    union CountIdPair {
+      uint32_t value;
+      struct {
+        uint16_t id;
+        uint16_t count;
+      };
+      CountIdPair(uint16_t id, uint16_t count) : id(id), count(count) {}
+      bool operator<(const CountIdPair &o) const { return value < o.value; }
+    };
+    vector<CountIdPair> count_id;
+    queue<Point> Q;
+    for (int y = 0; y < 32; ++y) {
+      for (int x = 0; x < 32; ++x) {
+        if (f[y][x] == 0 && state.isEmpty(x, y)) {
+          count++;
+          f[y][x] = count;
+          count_id.emplace_back(count, 1);
+          Q.emplace(x, y);
+          while (!Q.empty()) {
+            auto p = Q.front();
+            Q.pop();
+            for (int r = 0; r < 4; ++r) {
+              const int nx = p.x + dx[r];
+              const int ny = p.y + dy[r];
+              if (isInsideField(nx, ny) && f[ny][nx] == 0 &&
+                  state.isEmpty(nx, ny)) {
+                f[ny][nx] = count;
+                count_id[count - 1].count++;
+                Q.emplace(nx, ny);
+              }
+            }
+          }
+        }
+      }
+    }
+
+    if (count == 0) return {};
+
+    // the smallest area next to a stone. an area walled off by obstacles can
+    // never be reached, so it is skipped.
+    sort(count_id.begin(), count_id.end());
+    for (auto best_area : count_id) {
+      for (int y = 0; y < 32; ++y) {
+        for (int x = 0; x < 32; ++x) {
+          if (f[y][x] == best_area.id) {
+            for (int r = 0; r < 4; ++r) {
+              int nx = x + dx[r];
+              int ny = y + dy[r];
+              if (isInsideField(nx, ny)) {
+                if (state.isStone(nx, ny)) {
+                  return {Point(x, y)};
+                }
+              }
+            }
+          }
+        }
+      }
+    }
+    return {};
+  }
+
+ private:
+  // under memory pressure: first cap the duplicate table to a quarter of the
+  // budget, then shrink the beam for the pending buckets and the rest of the
+  // run.
+  void checkMemory(vector<StateBucket> &state_av,
+                   vector<SpillBucket> &spill_av, int k, int &beam_width) {
+    typedef google::dense_hash_map<uint32_t, int>::value_type Entry;
+    size_t bucket_bytes = 0;
+    for (int j = 0; j <= k; ++j) bucket_bytes += state_av[j].bytes();
+    for (auto &b : spill_av) bucket_bytes += b.bytes();
+    MemoryBudget::account(memory_budget.bucket_bytes, bucket_bytes_,
+                          bucket_bytes);
+    MemoryBudget::account(memory_budget.table_bytes, table_bytes_,
+                          hash_map.bucket_count() * sizeof(Entry));
+    memory_budget.update();
+    if (!memory_budget.pressed(mem_limit_)) return;
+    // slabs are not given back during a run, so committed memory does not
+    // fall after a cut; only react again once it has grown past the point
+    // of the last reaction.
+    const size_t committed = memory_budget.committed();
+    if (committed <= pressed_at_) return;
+    pressed_at_ = committed;
+    if (table_bytes_ > mem_limit_ / 4) {
+      size_t buckets = 32;
+      while (buckets * 2 * sizeof(Entry) <= mem_limit_ / 4) {
+        buckets *= 2;
+      }
+      table_cap_ = buckets * hash_map.max_load_factor() * 0.9;
+      hash_map.clear();
+      MemoryBudget::account(memory_budget.table_bytes, table_bytes_,
+                            hash_map.bucket_count() * sizeof(Entry));
+      cerr << "[memory] near limit, duplicate table capped at " << table_cap_
+           << " entries" << endl;
+      if (!memory_budget.pressed(mem_limit_)) return;
+    }
+    if (beam_width > 1) {
+      beam_width = max(1, beam_width * 3 / 4);
+      beam_limit_ = beam_width;
+      for (int j = 0; j <= k; ++j) state_av[j].shrink(beam_width);
+      for (auto &b : spill_av) b.shrink(beam_width);
+      cerr << "[memory] near limit, beam width " << beam_width << endl;
+    }
+  }
+
+  // replay an answer in orientation 0. Every prefix in `depths` equal parts
+  // is kept in seeds_ (none when depths is 0), and the whole answer may
+  // become the best state.
+  void loadSeed(const string &file, int depths, GameState **best) {
+    ifstream ifs(file);
+    if (!ifs) throw SolverError("cannnot open the seed file. " + file);
+    const auto puts =
+        GameState::fromAnswer(SolverAnswerReader::read(ifs, problem_));
+    // available() only looks around the origin cell, which is enough for the
+    // puts this solver generates but not for an arbitrary answer.
+    auto placeable = [](const GameState &s, const Put &put) {
+      if (s.isUsed(put.id)) return false;
+      bool touch = s.isFirstStone();
+      for (const auto &pos : g->stone_pattern_vector[put.id][put.r]) {
+        const int x = put.x + pos.x;
+        const int y = put.y + pos.y;
+        if (!isInsideField(x, y) || !s.isEmpty(x, y)) return false;
+        for (int r = 0; r < 4; ++r) {
+          const int nx = x + dx[r];
+          const int ny = y + dy[r];
+          if (isInsideField(nx, ny) && s.isStone(nx, ny) &&
+              s.getField()[ny][nx] < put.id) {
+            touch = true;
+          }
+        }
+      }
+      return touch;
+    };
+    GameState *s = GameState::alloc()->init();
+    int n = 0, kept = 0;
+    for (; n < (int)puts.size(); ++n) {
+      if (!placeable(*s, puts[n])) {
+        cerr << "[seed] stone " << (int)puts[n].id
+             << " cannot be placed, the seed is cut there" << endl;
+        break;
+      }
+      s->addScore(s->calcSimpleScore(puts[n]));
+      s->put(puts[n]);
+      for (int d = 1; d <= depths; ++d) {
+        if (n + 1 == (int)puts.size() * d / depths) {
+          seeds_.push_back(s->clone());
+          kept = n + 1;
+          break;
+        }
+      }
+    }
+    if (depths && n > kept) seeds_.push_back(s->clone());
+    cerr << "[seed] " << n << " stones, empty " << s->getEmptyCount()
+         << ", " << seeds_.size() << " prefixes" << endl;
+    if (n > 0 && (s->getEmptyCount() < (*best)->getEmptyCount() ||
+                  (s->getEmptyCount() == (*best)->getEmptyCount() &&
+                   s->getUsedMask().count() <
+                       (*best)->getUsedMask().count()))) {
+      GameState::free(*best);
+      *best = s;
+      last_output_hash_ = s->getHash();
+    } else {
+      GameState::free(s);
+    }
+  }
+
+  // write the search state at the start of level k to checkpoint_file_
+  // through a temporary file and rename, so a crash never leaves it torn.
+  void saveCheckpoint(vector<StateBucket> &state_av,
+                      vector<SpillBucket> &spill_av, int k, int beam_width,
+                      const GameState &best) {
+    const string tmp = checkpoint_file_ + ".tmp";
+    ofstream ofs(tmp, ios::binary);
+    if (!ofs) {
+      cerr << "cannnot open the checkpoint file. " << tmp << endl;
+      return;
+    }
+    CheckpointHeader h = {{'P', '2', '6', 'C'}, 1, problem_.hash(),
+                          current_trans_, k, beam_width, g->weight_diff_id,
+                          best_t_, last_output_hash_};
+    ofs.write(reinterpret_cast<const char *>(&h), sizeof(h));
+    vector<uint8_t> buf;
+    auto write_state = [&ofs, &buf](const GameState &s) {
+      buf.clear();
+      s.encode(buf);
+      ofs.write(reinterpret_cast<const char *>(buf.data()), buf.size());
+    };
+    write_state(best);
+    for (int32_t e = k; e >= 0; --e) {
+      uint32_t count = state_av[e].size();
+      if (!spill_av.empty()) count += spill_av[e].size();
+      if (count == 0) continue;
+      ofs.write(reinterpret_cast<const char *>(&e), sizeof(e));
+      ofs.write(reinterpret_cast<const char *>(&count), sizeof(count));
+      // in arrival order, which a resumed run pushes them in again: the
+      // spilled states came before the ones held in memory.
+      if (!spill_av.empty()) {
+        spill_av[e].scan([&ofs](const uint8_t *p, size_t n) {
+          ofs.write(reinterpret_cast<const char *>(p), n);
+        });
+      }
+      state_av[e].sortByArrival();
+      for (auto *s : state_av[e].state) write_state(*s);
+    }
+    const int32_t end = -1;
+    ofs.write(reinterpret_cast<const char *>(&end), sizeof(end));
+    const uint64_t table_size = hash_map.size();
+    ofs.write(reinterpret_cast<const char *>(&table_size), sizeof(table_size));
+    for (const auto &kv : hash_map) {
+      ofs.write(reinterpret_cast<const char *>(&kv.first), sizeof(kv.first));
+      ofs.write(reinterpret_cast<const char *>(&kv.second), sizeof(kv.second));
+    }
+    ofs.close();
+    if (!ofs || rename(tmp.c_str(), checkpoint_file_.c_str()) != 0) {
+      cerr << "cannnot write the checkpoint file. " << checkpoint_file_
+           << endl;
+      return;
+    }
+    cerr << "[checkpoint] trans " << current_trans_ << " level " << k << endl;
+  }
+
+  // restore a checkpoint written by saveCheckpoint. The pending states are
+  // appended to init, and the orientation to continue from is returned.
+  int loadCheckpoint(const string &file, vector<GameState *> &init,
+                     GameState **best) {
+    ifstream ifs(file, ios::binary);
+    CheckpointHeader h;
+    if (!ifs || !ifs.read(reinterpret_cast<char *>(&h), sizeof(h)) ||
+        memcmp(h.magic, "P26C", 4) != 0 || h.version != 1) {
+      throw SolverError("cannnot read the checkpoint file. " + file);
+    }
+    if (h.problem_hash != problem_.hash()) {
+      throw SolverError("the checkpoint is for another problem. " + file);
+    }
+    if (h.trans < 0 || h.trans >= 8 || h.beam_width < 1) {
+      throw SolverError("the checkpoint file is corrupt. " + file);
+    }
+    // the states read so far go back to the pool before any error.
+    const size_t first = init.size();
+    GameState *read_best = nullptr;
+    auto fail = [&init, first, &read_best](const string &message) {
+      for (size_t i = first; i < init.size(); ++i) GameState::free(init[i]);
+      init.resize(first);
+      if (read_best) GameState::free(read_best);
+      throw SolverError(message);
+    };
+    vector<uint8_t> buf;
+    auto read_state = [this, &ifs, &buf, &file, &fail]() {
+      StateRecord r;
+      if (!ifs.read(reinterpret_cast<char *>(&r), sizeof(r))) {
+        fail("the checkpoint file is truncated. " + file);
+      }
+      if (r.put_count > problem_.stone_list.size()) {
+        fail("the checkpoint file is corrupt. " + file);
+      }
+      buf.resize(r.size());
+      memcpy(buf.data(), &r, sizeof(r));
+      if (!ifs.read(reinterpret_cast<char *>(&buf[sizeof(r)]),
+                    r.size() - sizeof(r))) {
+        fail("the checkpoint file is truncated. " + file);
+      }
+      GameState *s = GameState::decodeChecked(buf.data(), buf.size());
+      if (!s) fail("the checkpoint file holds an invalid state. " + file);
+      return s;
+    };
+    read_best = read_state();
+    int32_t e;
+    while (ifs.read(reinterpret_cast<char *>(&e), sizeof(e)) && e >= 0) {
+      uint32_t count;
+      if (!ifs.read(reinterpret_cast<char *>(&count), sizeof(count))) {
+        fail("the checkpoint file is truncated. " + file);
+      }
+      for (uint32_t i = 0; i < count; ++i) init.push_back(read_state());
+    }
+    uint64_t table_size = 0;
+    ifs.read(reinterpret_cast<char *>(&table_size), sizeof(table_size));
+    for (uint64_t i = 0; i < table_size; ++i) {
+      uint32_t key;
+      int value;
+      ifs.read(reinterpret_cast<char *>(&key), sizeof(key));
+      ifs.read(reinterpret_cast<char *>(&value), sizeof(value));
+      hash_map[key] = value;
+    }
+    if (!ifs) fail("the checkpoint file is truncated. " + file);
+    GameState::free(*best);
+    *best = read_best;
+    g->weight_diff_id = h.weight;
+    beam_limit_ = h.beam_width;
+    best_t_ = h.best_trans;
+    last_output_hash_ = h.last_output_hash;
+    cerr << "[checkpoint] resume trans " << h.trans << " level " << h.level
+         << " states " << init.size() << endl;
+    return h.trans;
+  }
+
+  void beamSearch(vector<GameState *> &init, GameState **best, int beam_width) {
+    beam_width = min(beam_width, beam_limit_);
+    vector<StateBucket> state_av(1024, StateBucket(beam_width));
+
+    // levels more than spill_distance_ below the current one go to disk.
+    vector<SpillBucket> spill_av(spill_dir_.empty() ? 0 : 1024);
+    for (int e = 0; e < (int)spill_av.size(); ++e) {
+      spill_av[e].open(spill_dir_ + "/spill_" + to_string(getpid()) + "_" +
+                           to_string(solver_id_) + "_" + to_string(e) +
+                           ".bin",
+                       beam_width);
+    }
+
+    // states are numbered as they enter a bucket, so that ties are broken
+    // the same way whether a bucket was spilled or not.
+    uint64_t arrivals = 0;
+    int k = 0;
+    for (GameState *p : init) k = max(k, p->getEmptyCount() + 1);
+    for (GameState *p : init) {
+      assert(!p->isFirstStone());
+      const int e = p->getEmptyCount();
+      if (!spill_av.empty() && e + spill_distance_ < k) {
+        if (spill_av[e].admits(p->getScore())) {
+          spill_av[e].push(*p, arrivals++);
+        }
+        GameState::free(p);
+      } else if (state_av[e].admits(p->getScore())) {
+        state_av[e].push(p, arrivals++);
+      } else {
+        GameState::free(p);
+      }
+    }
+    init.clear();
+    const int top = k - 1;
+
+    // children that can neither improve best nor enter their bucket are
+    // rejected before the clone.
+    auto add_next = [this, &state_av, &spill_av, &k, &best, &arrivals](
+        GameState *p, Put put, int score) {
+      const int e =
+          p->getEmptyCount() - g->stone_pattern_vector[put.id][put.r].size();
+      const size_t used = p->getUsedMask().count() + 1;
+      const bool improved =
+          (*best)->getEmptyCount() > e ||
+          ((*best)->getEmptyCount() == e &&
+           (*best)->getUsedMask().count() > used);
+      if (e == 0) {
+        g->total_complete_count++;
+      }
+      auto &bucket = state_av[e];
+      const bool spill = !spill_av.empty() && e + spill_distance_ < k;
+      const bool admitted = spill ? spill_av[e].admits(p->getScore() + score)
+                                  : bucket.admits(p->getScore() + score);
+      if (!improved && !admitted) return false;
+      auto *s = p->clone();
+      s->addScore(score);
+      s->put(put);
+      if (improved) {
+        GameState::free(*best);
+        *best = s->clone();
+        if (on_progress) reportProgress(**best);
+        if (heartbeat_) {
+          heartbeat_->best(e, (int)(*best)->getUsedMask().count());
+        }
+        if (writer_) streamBest(**best);
+      }
+      if (admitted && !spill) {
+        bucket.push(s, arrivals++);
+      } else {
+        if (admitted) spill_av[e].push(*s, arrivals++);
+        GameState::free(s);
+      }
+      return admitted;
+    };
+
+    while (k--) {
+      if (cancelled_) {
+        for (int j = 0; j <= k; ++j) state_av[j].clear();
+        break;
+      }
+      if (stream_pending_) streamBest(**best);
+      auto &v = state_av[k];
+      if (!spill_av.empty()) {
+        spill_av[k].drain([&v](GameState *s, uint64_t arrival) {
+          if (v.admits(s->getScore(), arrival)) {
+            v.push(s, arrival);
+          } else {
+            GameState::free(s);
+          }
+        });
+      }
+      if (v.empty()) continue;
+      if (heartbeat_) {
+        heartbeat_->level(current_trans_, k, top,
+                          stats_.expanded + expanded_count_);
+      }
+      TraceSpan span("level");
+      span.arg("trans", current_trans_);
+      span.arg("level", k);
+      const auto level_start = chrono::steady_clock::now();
+      if (perf_) perf_->start();
+      LevelStats stats;
+      stats.trans = current_trans_;
+      stats.level = k;
+      stats.in = v.size();
+      if (!checkpoint_file_.empty() &&
+          chrono::steady_clock::now() - last_checkpoint_ >=
+              chrono::seconds(checkpoint_interval_)) {
+        TraceSpan checkpoint_span("checkpoint");
+        saveCheckpoint(state_av, spill_av, k, beam_width, **best);
+        last_checkpoint_ = chrono::steady_clock::now();
+      }
+      if (mem_limit_) checkMemory(state_av, spill_av, k, beam_width);
+
+      if (dedup_) v.dropDominated(hash_map);
+      stats.unique = v.size();
+      v.selectTop(beam_width);
+      stats.kept = v.size();
+      v.sortByArrival();
+
+      // only the state prefetch_distance_ slots ahead is prefetched, not the
+      // stone-pattern rows it will read: those depend on its target cell,
+      // which only the flood fill in getNextTargetPos finds, and they are
+      // shared by every state (stone_pattern_mask is 32 KB), so they are
+      // already cached after the first expansion of the level.
+      for (int i = 0; i < v.size(); ++i) {
+        if (prefetch_distance_ && i + prefetch_distance_ < v.size()) {
+          v.state[i + prefetch_distance_]->prefetch();
+        }
+        auto &state = *v.state[i];
+        if (hash_map.size() >= table_cap_) {
+          TraceSpan clear_span("clearTable");
+          hash_map.clear_no_resize();
+        }
+        auto pos_list = getNextTargetPos(state);
+        for (auto &pos : pos_list) {
+          auto available_list = state.getAvailableList(pos.x, pos.y);
+          for (auto put : available_list) {
+            // if (g->stone_pattern_vector[put.id][put.r].size() == 1) continue;
+            const auto sc = state.calcSimpleScore(put);
+            const auto hash = state.preHash(put);
+            stats.children++;
+            PROCON26_COUNT(kHashProbe);
+            if (hash_map[hash] > state.getScore() + sc) {
+              stats.duplicates++;
+              continue;
+            }
+            hash_map[hash] = state.getScore() + sc;
+            if (!add_next(&state, put, sc)) stats.rejects++;
+          }
+        }
+        GameState::free(&state);
+      }
+      expanded_count_ += v.size();
+      span.arg("kept", v.size());
+      span.arg("children", stats.children);
+      v.release();
+      if (stats_sink_) {
+        stats.seconds = chrono::duration<double>(chrono::steady_clock::now() -
+                                                 level_start).count();
+        stats.perf = perf_->stop();
+        stats_sink_->write(stats);
+      }
+    }
+    MemoryBudget::account(memory_budget.bucket_bytes, bucket_bytes_, 0);
+  }
+
+  // hands the best state to the answer writer at most once per
+  // answer_interval_; a skipped one is retried at the next bucket.
+  void streamBest(const GameState &best) {
+    stream_pending_ = true;
+    const auto now = chrono::steady_clock::now();
+    if (now - last_stream_ < answer_interval_) return;
+    last_stream_ = now;
+    stream_pending_ = false;
+    writer_->post(best.toAnswer(), best.getEmptyCount(),
+                  (int)best.getUsedMask().count());
+  }
+
+  void reportProgress(const GameState &best) {
+    SolverProgress progress;
+    progress.empty = best.getEmptyCount();
+    progress.stones = (int)best.getUsedMask().count();
+    progress.elapsed = chrono::duration<double>(chrono::steady_clock::now() -
+                                                start_time_).count();
+    progress.answer = [&best]() { return best.toAnswer(); };
+    on_progress(progress);
+  }
+
+  void firstPut(int trans, vector<GameState *> &dst) {
+    TraceSpan span("firstPut");
+    span.arg("trans", trans);
+    GameState *a = GameState::alloc()->init();
+    a->trans(trans);
+    for (int y = 0; y < 32; ++y) {
+      for (int x = 0; x < 32; ++x) {
+        auto putList = a->getAvailableList(x, y);
+        if (!putList.empty()) {
+          for (auto put : putList) {
+            GameState *b = a->clone();
+            b->addScore(b->calcSimpleScore(put));
+            b->put(put);
+            dst.push_back(b);
+          }
+          GameState::free(a);
+          return;
+        }
+      }
+    }
+    GameState::free(a);
+  }
+
+  SolverAnswer solve() {
+    if (parameter_.extra_parameter.find("w") !=
+        parameter_.extra_parameter.end()) {
+      cerr << "setting weight" << parameter_.extra_parameter["w"] << endl;
+      g->weight_diff_id = std::stoi(parameter_.extra_parameter["w"]);
+      cerr << g->weight_diff_id << endl;
+    }
+    if (parameter_.extra_parameter.find("beam") !=
+        parameter_.extra_parameter.end()) {
+      beam_width_ = max(1, std::stoi(parameter_.extra_parameter["beam"]));
+    }
+    if (parameter_.extra_parameter.find("answer_prefix") !=
+        parameter_.extra_parameter.end()) {
+      answer_prefix_ = parameter_.extra_parameter["answer_prefix"];
+    }
+    if (parameter_.extra_parameter.find("answer_files") !=
+        parameter_.extra_parameter.end()) {
+      answer_files_ = parameter_.extra_parameter["answer_files"] != "0";
+    }
+    if (parameter_.extra_parameter.find("prefetch") !=
+        parameter_.extra_parameter.end()) {
+      prefetch_distance_ = std::stoi(parameter_.extra_parameter["prefetch"]);
+    }
+    // the memory options of an earlier run on this solver or this thread
+    // must not carry over.
+    GameState::huge_page_ = false;
+    if (parameter_.extra_parameter.find("hugepage") !=
+        parameter_.extra_parameter.end()) {
+      GameState::huge_page_ = parameter_.extra_parameter["hugepage"] != "0";
+    }
+    if (parameter_.extra_parameter.find("dedup") !=
+        parameter_.extra_parameter.end()) {
+      dedup_ = parameter_.extra_parameter["dedup"] != "0";
+    }
+    if (parameter_.extra_parameter.find("spill") !=
+        parameter_.extra_parameter.end()) {
+      spill_dir_ = parameter_.extra_parameter["spill"];
+    }
+    if (parameter_.extra_parameter.find("spill_distance") !=
+        parameter_.extra_parameter.end()) {
+      spill_distance_ =
+          std::stoi(parameter_.extra_parameter["spill_distance"]);
+    }
+    mem_limit_ = 0;
+    if (parameter_.extra_parameter.find("mem_limit") !=
+        parameter_.extra_parameter.end()) {
+      mem_limit_ =
+          std::stoul(parameter_.extra_parameter["mem_limit"]) * 1024 * 1024;
+    }
+    GameState::slab_limit_ = mem_limit_;
+    beam_limit_ = std::numeric_limits<int>::max();
+    pressed_at_ = 0;
+    table_cap_ = std::numeric_limits<size_t>::max();
+    if (parameter_.extra_parameter.find("checkpoint") !=
+        parameter_.extra_parameter.end()) {
+      checkpoint_file_ = parameter_.extra_parameter["checkpoint"];
+    }
+    if (parameter_.extra_parameter.find("checkpoint_interval") !=
+        parameter_.extra_parameter.end()) {
+      checkpoint_interval_ =
+          std::stoi(parameter_.extra_parameter["checkpoint_interval"]);
+    }
+    if (parameter_.extra_parameter.find("answer_interval") !=
+        parameter_.extra_parameter.end()) {
+      answer_interval_ = chrono::milliseconds(
+          std::stoi(parameter_.extra_parameter["answer_interval"]));
+    }
+    if (answer_files_) {
+      writer_.reset(new AnswerWriter(problem_, answer_prefix_));
+    }
+    if (parameter_.extra_parameter.find("stats") !=
+        parameter_.extra_parameter.end()) {
+      stats_sink_.reset(new StatsSink(parameter_.extra_parameter["stats"]));
+      perf_.reset(new PerfCounters);
+      if (!perf_->available()) {
+        cerr << "[stats] perf_event_open denied, levels are timed only"
+             << endl;
+      }
+    }
+    last_checkpoint_ = chrono::steady_clock::now();
+    int heartbeat_interval = 1000;
+    if (parameter_.extra_parameter.find("heartbeat_interval") !=
+        parameter_.extra_parameter.end()) {
+      heartbeat_interval =
+          max(1, std::stoi(parameter_.extra_parameter["heartbeat_interval"]));
+    }
+    GameState *best_state = GameState::alloc()->init();
+    last_output_hash_ = best_state->getHash();
+
+    if (parameter_.extra_parameter.find("seed") !=
+        parameter_.extra_parameter.end()) {
+      int depths = 4;
+      if (parameter_.extra_parameter.find("seed_depths") !=
+          parameter_.extra_parameter.end()) {
+        depths = max(1, std::stoi(parameter_.extra_parameter["seed_depths"]));
+      }
+      loadSeed(parameter_.extra_parameter["seed"], depths, &best_state);
+    }
+
+    if (parameter_.extra_parameter.find("cache") !=
+        parameter_.extra_parameter.end()) {
+      cache_.reset(new ResultCache(parameter_.extra_parameter["cache"],
+                                   problem_.hash()));
+      if (cache_->hasAnswer()) {
+        cerr << "[cache] best empty " << cache_->best_empty << " stones "
+             << cache_->best_stones << " after " << cache_->seconds() << " s"
+             << endl;
+        loadSeed(cache_->answerFile(), 0, &best_state);
+      }
+    }
+
+    int start_trans = 0;
+    vector<GameState *> resumed;
+    if (parameter_.extra_parameter.find("resume") !=
+        parameter_.extra_parameter.end()) {
+      start_trans = loadCheckpoint(parameter_.extra_parameter["resume"],
+                                   resumed, &best_state);
+    }
+    // a best answer from the seed, the cache or the checkpoint is known
+    // before the search improves on it.
+    if (on_progress && best_state->getUsedMask().any()) {
+      reportProgress(*best_state);
+    }
+
+    if (parameter_.extra_parameter.find("heartbeat") !=
+        parameter_.extra_parameter.end()) {
+      heartbeat_.reset(new Heartbeat(parameter_.extra_parameter["heartbeat"],
+                                     chrono::milliseconds(heartbeat_interval),
+                                     start_trans));
+      heartbeat_->best(best_state->getEmptyCount(),
+                       (int)best_state->getUsedMask().count());
+    }
+
+    auto run_and_update = [this, &best_state, &resumed](int trans,
+                                                        int beam_width) {
+      ResultCache::Config config = {trans, beam_width, g->weight_diff_id,
+                                    searchOptions()};
+      if (cache_ && resumed.empty() && cache_->hasRun(config)) {
+        cerr << "[cache] skip trans " << trans << endl;
+        if (heartbeat_) heartbeat_->orientationDone();
+        return;
+      }
+      vector<GameState *> init;
+      current_trans_ = trans;
+      if (!resumed.empty()) {
+        init.swap(resumed);
+      } else {
+        firstPut(trans, init);
+        for (auto *seed : seeds_) {
+          init.push_back(seed->clone());
+          init.back()->trans(trans);
+        }
+      }
+      const auto start = chrono::steady_clock::now();
+      expanded_count_ = 0;
+      {
+        TraceSpan span("beamSearch");
+        span.arg("trans", trans);
+        beamSearch(init, &best_state, beam_width);
+      }
+      const double sec = chrono::duration<double>(
+                             chrono::steady_clock::now() - start).count();
+      cerr << "[beam] trans " << trans << " expanded " << expanded_count_
+           << " states " << sec << " s " << expanded_count_ / max(sec, 1e-9)
+           << " states/s" << endl;
+      stats_.expanded += expanded_count_;
+      stats_.search_seconds += sec;
+      {
+        TraceSpan span("clearTable");
+        hash_map.clear_no_resize();
+      }
+      if (last_output_hash_ != best_state->getHash()) {
+        last_output_hash_ = best_state->getHash();
+        best_t_ = trans;
+        auto ans = best_state->toAnswer();
+        auto ec = best_state->getEmptyCount();
+        auto uc = (int)best_state->getUsedMask().count();
+        if (writer_) writer_->post(ans, ec, uc);
+        if (on_answer) on_answer(ans, ec, uc);
+        // a mem_limit cut makes this a narrower run than was asked for.
+        config.beam_width = min(beam_width, beam_limit_);
+        if (cache_) cache_->update(problem_, ans, ec, uc, config);
+      }
+      config.beam_width = min(beam_width, beam_limit_);
+      if (cache_) cache_->addRun(config, sec);
+      if (heartbeat_) heartbeat_->orientationDone();
+    };
+
+    for (int t = start_trans; t < 8 && !cancelled_; ++t) {
+      run_and_update(t, beam_width_);
+    }
+
+    /*
+            for (int w = 1000; w <= 4000; w += 1000) {
+                    run_and_update(best_t_, w);
+            }
+     */
+
+    visualize(*best_state);
+
+    auto ans = best_state->toAnswer();
+    stats_.empty = best_state->getEmptyCount();
+    stats_.stones = (int)best_state->getUsedMask().count();
+    GameState::free(best_state);
+    writer_.reset();
+    heartbeat_.reset();
+    for (auto *seed : seeds_) GameState::free(seed);
+    seeds_.clear();
+    MemoryBudget::account(memory_budget.table_bytes, table_bytes_, 0);
+    memory_budget.report(cerr, mem_limit_);
+
+#ifdef DEBUG_MEMORY_CHECK
+    cerr << "[last] alloc " << g->total_alloc_count << " free "
+         << g->total_free_count << endl;
+    assert(g->total_alloc_count == g->total_free_count);
+#endif
+    return ans;
+  }
+
+  // every extra option that can change what the search finds, as
+  // "key=value" pairs; only output and bookkeeping options are left out.
+  // A seed is keyed by the contents of its file.
+  string searchOptions() {
+    static const set<string> ignored = {
+        "answer_files", "answer_interval", "answer_prefix", "beam", "cache",
+        "checkpoint", "checkpoint_interval", "heartbeat",
+        "heartbeat_interval", "jobs", "resume", "stats", "trace", "w"};
+    string options;
+    for (const auto &kv : parameter_.extra_parameter) {
+      if (ignored.count(kv.first)) continue;
+      string value = kv.second;
+      if (kv.first == "seed") {
+        ifstream ifs(value);
+        const string text((istreambuf_iterator<char>(ifs)),
+                          istreambuf_iterator<char>());
+        value = to_string(hash<string>()(text));
+      }
+      for (auto &c : value) {
+        if (isspace((unsigned char)c)) c = '_';
+      }
+      options += (options.empty() ? "" : ",") + kv.first + "=" + value;
+    }
+    return options;
+  }
+
+  // gv output of the best state and its put sequence.
+  void visualize(GameState &best_state);
+
+  const Problem &problem_;
+  SolverParameter &parameter_;
+  SolverContext context_;
+  atomic<bool> cancelled_{false};
+  int solver_id_;
+  string answer_prefix_;
+  bool answer_files_ = true;
+  google::dense_hash_map<uint32_t, int> hash_map;
+  int beam_width_ = 100;
+  int prefetch_distance_ = 2;
+  size_t mem_limit_ = 0;  // bytes, 0 for none
+  int beam_limit_ = std::numeric_limits<int>::max();
+  size_t pressed_at_ = 0;  // committed bytes at the last memory reaction
+  bool dedup_ = false;  // -ex dedup: drop states beaten on the same hash
+  size_t table_cap_ = std::numeric_limits<size_t>::max();
+  string spill_dir_;
+  int spill_distance_ = 8;
+  string checkpoint_file_;
+  int checkpoint_interval_ = 60;
+  chrono::steady_clock::time_point start_time_;
+  chrono::steady_clock::time_point last_checkpoint_;
+  int current_trans_ = 0;
+  int best_t_ = 0;
+  uint32_t last_output_hash_ = 0;
+  vector<GameState *> seeds_;
+  unique_ptr<ResultCache> cache_;
+  unique_ptr<AnswerWriter> writer_;
+  unique_ptr<StatsSink> stats_sink_;
+  unique_ptr<PerfCounters> perf_;  // of the solving thread, with stats_sink_
+  unique_ptr<Heartbeat> heartbeat_;  // -ex heartbeat, null without it
+  chrono::milliseconds answer_interval_{1000};
+  chrono::steady_clock::time_point last_stream_;
+  bool stream_pending_ = false;
+  size_t expanded_count_ = 0;
+  SolverStats stats_;
+  size_t bucket_bytes_ = 0;
+  size_t table_bytes_ = 0;
+};
@@ -0,0 +1,160 @@
+﻿/*
+The MIT License (MIT)
+
+Copyright (c) 2015 Shingo INADA
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#include "trace.hpp"
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <unistd.h>
+
+using namespace std;
+
+atomic<bool> Trace::enabled_(false);
+
+namespace {
+
+struct Event {
+  const char *name;
+  int64_t start, end;
+  string args;
+};
+
+// one per thread. Only its owner appends, but flush takes the events from
+// another thread, hence the mutex; the owner never waits on anyone else.
+struct ThreadBuffer {
+  int tid;
+  mutex m;
+  vector<Event> events;
+  bool named = false;  // its thread_name event is in the open file
+};
+
+const char kTrailer[] = "\n]}\n";
+
+mutex registry_mutex;
+string trace_file;
+ofstream trace_out;
+bool trace_empty = true;  // no event written to trace_out yet
+int traced_runs = 0;
+vector<unique_ptr<ThreadBuffer>> buffers;
+
+const chrono::steady_clock::time_point &epoch() {
+  static const auto t = chrono::steady_clock::now();
+  return t;
+}
+
+ThreadBuffer &threadBuffer() {
+  static thread_local ThreadBuffer *buffer = []() {
+    lock_guard<mutex> lock(registry_mutex);
+    buffers.emplace_back(new ThreadBuffer);
+    buffers.back()->tid = (int)buffers.size() - 1;
+    return buffers.back().get();
+  }();
+  return *buffer;
+}
+
+// writes the buffered events before the trailer and empties the buffers.
+// Called with registry_mutex held.
+void flushLocked() {
+  const int pid = (int)getpid();
+  for (auto &buffer : buffers) {
+    vector<Event> events;
+    {
+      lock_guard<mutex> buffer_lock(buffer->m);
+      events.swap(buffer->events);
+    }
+    if (!trace_out.is_open()) continue;
+    if (!buffer->named) {
+      trace_out << (trace_empty ? "" : ",\n")
+                << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":" << pid
+                << ",\"tid\":" << buffer->tid << ",\"args\":{\"name\":\"thread "
+                << buffer->tid << "\"}}";
+      trace_empty = false;
+      buffer->named = true;
+    }
+    for (const auto &e : events) {
+      trace_out << ",\n{\"name\":\"" << e.name << "\",\"ph\":\"X\",\"ts\":"
+                << e.start << ",\"dur\":" << e.end - e.start
+                << ",\"pid\":" << pid << ",\"tid\":" << buffer->tid
+                << ",\"args\":{" << e.args << "}}";
+    }
+  }
+  if (!trace_out.is_open()) return;
+  const auto end = trace_out.tellp();
+  trace_out << kTrailer << flush;
+  trace_out.seekp(end);
+}
+
+// destroyed before the registry above it.
+struct FlushAtExit {
+  ~FlushAtExit() { Trace::flush(); }
+} flush_at_exit;
+
+}  // namespace
+
+void Trace::open(const string &file) {
+  epoch();
+  lock_guard<mutex> lock(registry_mutex);
+  if (file != trace_file || !trace_out.is_open()) {
+    if (trace_out.is_open()) flushLocked();
+    trace_out.close();
+    trace_file = file;
+    trace_out.open(file, ios::trunc);
+    if (!trace_out) {
+      cerr << "cannnot open the trace file. " << file << endl;
+      trace_out.close();
+    } else {
+      trace_out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+      trace_empty = true;
+      for (auto &buffer : buffers) buffer->named = false;
+      flushLocked();
+    }
+  }
+  ++traced_runs;
+  enabled_ = trace_out.is_open();
+}
+
+void Trace::close() {
+  lock_guard<mutex> lock(registry_mutex);
+  flushLocked();
+  if (--traced_runs == 0) enabled_ = false;
+}
+
+int64_t Trace::now() {
+  return chrono::duration_cast<chrono::microseconds>(
+             chrono::steady_clock::now() - epoch()).count();
+}
+
+void Trace::complete(const char *name, int64_t start, int64_t end,
+                     const string &args) {
+  auto &buffer = threadBuffer();
+  lock_guard<mutex> lock(buffer.m);
+  buffer.events.push_back({name, start, end, args});
+}
+
+void Trace::flush() {
+  lock_guard<mutex> lock(registry_mutex);
+  flushLocked();
+}
@@ -0,0 +1,84 @@
+﻿/*
+The MIT License (MIT)
+
+Copyright (c) 2015 Shingo INADA
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+// `-ex trace file.json`: spans in the Chrome trace_event format, for
+// chrome://tracing or Perfetto. The collector is shared by every solver of
+// the process and each thread records into its own buffer, so a batch run
+// shows one row per worker. Recording is on only while some run traces.
+// Each flush appends the buffered events to the file, rewrites its closing
+// bracket so it stays valid JSON, and empties the buffers; runs on the same
+// file keep appending to it.
+class Trace {
+ public:
+  // starts recording for one run; opens `file` unless it is already open.
+  static void open(const std::string &file);
+
+  // flushes and ends the recording of one run.
+  static void close();
+
+  static bool enabled() { return enabled_.load(std::memory_order_relaxed); }
+
+  // microseconds since the first open.
+  static int64_t now();
+
+  // a complete ("X") event; `args` is the inside of a JSON object.
+  static void complete(const char *name, int64_t start, int64_t end,
+                       const std::string &args);
+
+  static void flush();
+
+ private:
+  static std::atomic<bool> enabled_;
+};
+
+// records the scope it lives in when tracing is enabled, and costs one
+// relaxed load otherwise.
+class TraceSpan {
+ public:
+  explicit TraceSpan(const char *name)
+      : name_(Trace::enabled() ? name : nullptr),
+        start_(name_ ? Trace::now() : 0) {}
+
+  ~TraceSpan() {
+    if (name_) Trace::complete(name_, start_, Trace::now(), args_);
+  }
+
+  void arg(const char *key, long long value) {
+    if (!name_) return;
+    if (!args_.empty()) args_ += ",";
+    args_ += std::string("\"") + key + "\":" + std::to_string(value);
+  }
+
+ private:
+  const char *name_;
+  int64_t start_;
+  std::string args_;
+};
@@ -0,0 +1,92 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2015 Shingo INADA
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#include "procon26.hpp"
+
+// board cells: 0 free, 1 obstacle, 2 stone. one spare row and column on
+// every side keeps the neighbour checks free of bounds tests.
+AnswerCheck verifyAnswer(const Problem &problem, const SolverAnswer &answer) {
+  AnswerCheck check;
+  auto error = [&check](int stone, const char *what) {
+    check.error = "stone " + std::to_string(stone) + ": " + what;
+    return check;
+  };
+  uint8_t board[34][34] = {{0}};
+  int free_cells = 0;
+  for (int y = 0; y < 34; ++y) {
+    for (int x = 0; x < 34; ++x) {
+      const bool inside = x > 0 && x < 33 && y > 0 && y < 33;
+      board[y][x] = !inside || problem.field[y - 1][x - 1];
+      free_cells += !board[y][x];
+    }
+  }
+
+  int last = -1;
+  int covered = 0;
+  for (const auto &put : answer.put_list) {
+    const int id = put.stone_index;
+    if (id < 0 || id >= (int)problem.stone_list.size()) {
+      return error(id, "no such stone");
+    }
+    if (id <= last) return error(id, "placed twice or out of order");
+    if (put.rotate < 0 || put.rotate > 3) return error(id, "bad rotation");
+    last = id;
+
+    int cells[64][2];
+    int n = 0;
+    bool touch = check.stones == 0;
+    const auto &stone = problem.stone_list[id];
+    for (int sy = 0; sy < 8; ++sy) {
+      for (int sx = 0; sx < 8; ++sx) {
+        if (!stone[sy][sx]) continue;
+        int x = put.flip ? 7 - sx : sx, y = sy;
+        for (int r = 0; r < put.rotate; ++r) {
+          const int t = x;
+          x = 7 - y;
+          y = t;
+        }
+        x += put.x + 1;
+        y += put.y + 1;
+        if (x < 1 || x > 32 || y < 1 || y > 32) {
+          return error(id, "outside the board");
+        }
+        if (board[y][x] == 1) return error(id, "on an obstacle");
+        if (board[y][x] == 2) return error(id, "overlaps a stone");
+        touch = touch || board[y - 1][x] == 2 || board[y + 1][x] == 2 ||
+                board[y][x - 1] == 2 || board[y][x + 1] == 2;
+        cells[n][0] = x;
+        cells[n][1] = y;
+        n++;
+      }
+    }
+    if (n == 0) return error(id, "empty stone");
+    if (!touch) return error(id, "does not touch an earlier stone");
+    for (int i = 0; i < n; ++i) board[cells[i][1]][cells[i][0]] = 2;
+    covered += n;
+    check.stones++;
+  }
+  check.valid = true;
+  check.empty = free_cells - covered;
+  return check;
+}